@@ -1,20 +1,19 @@
 #version 450
 
-layout (location = 0) out vec3 color;
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec3 inColor;
 
-vec2 positions[3] = {
-	vec2(-0.5, -0.5),
-	vec2(0.5, -0.5),
-	vec2(0.0, 0.5)
-};
+// Per instance: offset.xy, scale, rotation & color
+layout (location = 2) in vec4 inTransform;
+layout (location = 3) in vec4 inInstanceColor;
 
-vec3 colors[3] = {
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-};
+layout (location = 0) out vec3 color;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	color = colors[gl_VertexIndex];
+	float c = cos(inTransform.w);
+	float s = sin(inTransform.w);
+	vec2 position = mat2(c, s, -s, c) * inPosition * inTransform.z;
+
+	gl_Position = vec4(position + inTransform.xy, 0.0, 1.0);
+	color = inColor * inInstanceColor.rgb;
 }
@@ -1,8 +1,10 @@
 #include "TriApp.hpp"
 
 #include "TriFileUtils.hpp"
+#include "TriGeometry.hpp"
 #include "TriGraphicsUtils.hpp"
 #include "TriLog.hpp"
+#include "TriShaderRegistry.hpp"
 
 #include <glm/glm.hpp>
 
@@ -14,29 +16,111 @@
 #include <limits>
 #include <set>
 
+// Shaders built by InitGraphicsPipeline() & InitCullPipeline()
+static const char *const kVertexShader = "triangle.vert";
+static const char *const kFragmentShader = "triangle.frag";
+static const char *const kCullShader = "cull.comp";
+
+// GPU profiler scopes, see ReadGpuTimings()
+static const char *const kGpuFrameScope = "frame";
+static const char *const kGpuCullScope = "cull";
+static const char *const kGpuDrawScope = "draw";
+
+static const char *PresentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo-relaxed";
+
+    default:
+        return "other";
+    }
+}
+
 void TriApp::Init()
 {
-    // Initialize GLFW window
-    if (!mpWindow)
+    mInitStartTime = TriClock::now();
+    mFirstFrameReported = false;
+    mInitSteps.Start();
+
+    TriCpuTraceSetThreadName("Main");
+
+    // Shader files are mapped & read while the instance and device come up
+    if (!mGraphicsPipeline && !mGraphicsPipelineFuture.valid())
+    {
+        std::vector<std::string> shaders{kVertexShader, kFragmentShader};
+        if (mSettings.gpuCulling)
+            shaders.emplace_back(kCullShader);
+
+        mShaderPreload =
+            std::async(std::launch::async, PreloadShaderCode, shaders);
+    }
+
+    /* Enumerating instance extensions & layers loads every layer manifest
+       (and often the layer libraries); overlap it with window creation
+    */
+    bool enumerateInstance =
+        mInstanceExtensions.empty() || mInstanceLayers.empty();
+    std::future<void> instanceEnumeration;
+
+    if (enumerateInstance)
+    {
+        instanceEnumeration = std::async(
+            std::launch::async,
+            [this]()
+            {
+                uint32_t numInstanceExtensions = 0;
+                vkEnumerateInstanceExtensionProperties(
+                    nullptr, &numInstanceExtensions, nullptr);
+                mInstanceExtensions.resize(numInstanceExtensions);
+                vkEnumerateInstanceExtensionProperties(
+                    nullptr, &numInstanceExtensions,
+                    mInstanceExtensions.data());
+
+                uint32_t numLayers = 0;
+                vkEnumerateInstanceLayerProperties(&numLayers, nullptr);
+                mInstanceLayers.resize(numLayers);
+                vkEnumerateInstanceLayerProperties(&numLayers,
+                                                   mInstanceLayers.data());
+            });
+    }
+
+    // Initialize GLFW window (not needed when rendering offscreen)
+    if (!mpWindow && !mSettings.headless)
     {
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
         mpWindow =
             glfwCreateWindow(width, height, mAppName.c_str(), nullptr, nullptr);
+
+        glfwSetWindowUserPointer(mpWindow, this);
+        glfwSetFramebufferSizeCallback(mpWindow,
+                                       TriApp::FramebufferResizeCallback);
+        glfwSetKeyCallback(mpWindow, TriApp::KeyCallback);
     }
 
+    if (instanceEnumeration.valid())
+        instanceEnumeration.wait();
+
+    mInitSteps.Mark("window & instance enumeration");
+
     std::vector<const char *> reqInstanceExtensions;
 
-    // Locate available instance extensions
-    if (mInstanceExtensions.empty())
+    // Check the available instance extensions
+    if (enumerateInstance)
     {
-        uint32_t numInstanceExtensions = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &numInstanceExtensions,
-                                               nullptr);
-        mInstanceExtensions.resize(numInstanceExtensions);
-        vkEnumerateInstanceExtensionProperties(nullptr, &numInstanceExtensions,
-                                               mInstanceExtensions.data());
+        size_t numInstanceExtensions = mInstanceExtensions.size();
 
         TriLogInfo() << "Number of available instance extensions: "
                      << numInstanceExtensions;
@@ -47,12 +131,15 @@ void TriApp::Init()
         }
 
         // Get extensions required from GLFW
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions =
-            glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        if (!mSettings.headless)
+        {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions =
+                glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-        reqInstanceExtensions =
-            std::vector(glfwExtensions, glfwExtensions + glfwExtensionCount);
+            reqInstanceExtensions = std::vector(
+                glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 #if TRI_WITH_VULKAN_VALIDATION
         reqInstanceExtensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
@@ -77,8 +164,8 @@ void TriApp::Init()
 
     std::vector<const char *> reqLayers;
 
-    // Locate available instance layers
-    if (mInstanceLayers.empty())
+    // Check the available instance layers
+    if (enumerateInstance)
     {
 #if TRI_WITH_VULKAN_VALIDATION
         // Req. layers
@@ -86,10 +173,7 @@ void TriApp::Init()
 
 #endif
 
-        uint32_t numLayers = 0;
-        vkEnumerateInstanceLayerProperties(&numLayers, nullptr);
-        mInstanceLayers.resize(numLayers);
-        vkEnumerateInstanceLayerProperties(&numLayers, mInstanceLayers.data());
+        size_t numLayers = mInstanceLayers.size();
 
         TriLogInfo() << "Number of available layers: " << numLayers;
 
@@ -119,6 +203,9 @@ void TriApp::Init()
     // Create Vulkan instance
     if (!mInstance)
     {
+        // Everything created from here on is destroyed with these callbacks
+        mHostAllocator.Init(mSettings.hostAllocator);
+
         VkApplicationInfo appInfo{};
         appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
         appInfo.pNext = nullptr;
@@ -126,7 +213,18 @@ void TriApp::Init()
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(0, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // Ask for up to 1.3, where dynamic rendering is core; 1.0 loaders
+        // lack vkEnumerateInstanceVersion altogether
+        PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+            reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+                vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+
+        mInstanceApiVersion = VK_API_VERSION_1_0;
+        if (enumerateInstanceVersion)
+            enumerateInstanceVersion(&mInstanceApiVersion);
+
+        mInstanceApiVersion = std::min(mInstanceApiVersion, VK_API_VERSION_1_3);
+        appInfo.apiVersion = mInstanceApiVersion;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -158,7 +256,9 @@ void TriApp::Init()
         createInfo.enabledLayerCount = reqLayers.size();
         createInfo.ppEnabledLayerNames = reqLayers.data();
 
-        VkResult result = vkCreateInstance(&createInfo, nullptr, &mInstance);
+        VkResult result = vkCreateInstance(&createInfo,
+                                           mHostAllocator.Callbacks(),
+                                           &mInstance);
         if (result != VK_SUCCESS)
         {
             TriLogError() << "Failed to create VkInstance: " << result;
@@ -169,7 +269,8 @@ void TriApp::Init()
         TriLogInfo() << "VkInstance created: " << mInstance;
     }
 
-    mLibrary.Init();
+    mLibrary.Init(mInstance);
+    mInitSteps.Mark("instance");
 
 #if TRI_WITH_VULKAN_VALIDATION
     if (!mDebugUtilsMessenger)
@@ -178,8 +279,13 @@ void TriApp::Init()
         VkDebugUtilsMessengerCreateInfoEXT createInfo{};
         PopulateDebugUtilsMessengerCreateInfoEXT(createInfo);
 
-        VkResult result = mLibrary.CreateDebugUtilsMessengerEXT(
-            mInstance, &createInfo, nullptr, &mDebugUtilsMessenger);
+        VkResult result = VK_ERROR_EXTENSION_NOT_PRESENT;
+        if (mLibrary.CreateDebugUtilsMessengerEXT)
+        {
+            result = mLibrary.CreateDebugUtilsMessengerEXT(
+                mInstance, &createInfo, mHostAllocator.Callbacks(),
+                &mDebugUtilsMessenger);
+        }
 
         if (result != VK_SUCCESS)
         {
@@ -187,13 +293,16 @@ void TriApp::Init()
                              "there will be no messages from validation layer";
         }
     }
+
+    mInitSteps.Mark("debug messenger");
 #endif
 
     // Create GLFW window surface
-    if (!mSurface)
+    if (!mSurface && !mSettings.headless)
     {
-        VkResult result =
-            glfwCreateWindowSurface(mInstance, mpWindow, nullptr, &mSurface);
+        VkResult result = glfwCreateWindowSurface(mInstance, mpWindow,
+                                                  mHostAllocator.Callbacks(),
+                                                  &mSurface);
 
         if (result != VK_SUCCESS)
         {
@@ -206,48 +315,59 @@ void TriApp::Init()
         TriLogInfo() << "Vulkan window surface created: " << mSurface;
     }
 
+    mInitSteps.Mark("surface");
+
     // Pick physical device extensions
-    std::vector<const char *> reqDeviceExtensions{
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char *> reqDeviceExtensions;
+    if (!mSettings.headless)
+    {
+        reqDeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     if (!mPhysicalDevice)
     {
-        uint32_t deviceCount = 0;
-        std::vector<VkPhysicalDevice> devices;
-        vkEnumeratePhysicalDevices(mInstance, &deviceCount, nullptr);
-        devices.resize(deviceCount);
-        vkEnumeratePhysicalDevices(mInstance, &deviceCount, devices.data());
+        mDeviceSelector.Init(mInstance, mInstanceApiVersion,
+                             mSettings.deviceCachePath);
 
-        TriLogInfo() << "Number of Vulkan-enabled devices: " << deviceCount;
+        TriLogInfo() << "Number of Vulkan-enabled devices: "
+                     << mDeviceSelector.GetProfiles().size();
 
-        std::vector<std::pair<int, VkPhysicalDevice>> suitableDevices;
+        // Whatever IsDeviceSuitable() looks at besides the device
+        std::string filterKey = mSettings.headless ? "headless" : "windowed";
+        for (const char *extension : reqDeviceExtensions)
+            filterKey += std::string(",") + extension;
 
-        for (size_t i = 0; i < deviceCount; i++)
-        {
-            VkPhysicalDevice device = devices[i];
-            int score = RateDeviceSuitability(device, reqDeviceExtensions);
-
-            if (score != 0)
-            {
-                suitableDevices.emplace_back(score, device);
-            }
-        }
+        const TriDeviceProfile *profile = mDeviceSelector.Select(
+            mSettings.devicePolicy, mSettings.deviceUUID, filterKey,
+            [&](const TriDeviceProfile &profile)
+            { return IsDeviceSuitable(profile, reqDeviceExtensions); });
 
-        if (suitableDevices.empty())
+        if (!profile)
         {
             TriLogError() << "No available Vulkan-enabled GPUs found";
             Finalize();
             return;
         }
 
-        std::sort(suitableDevices.begin(), suitableDevices.end(),
-                  [](const auto &left, const auto &right)
-                  { return left.first < right.first; });
+        mDeviceProfile = *profile;
+        mPhysicalDevice = mDeviceProfile.device;
+
+        TriLogInfo() << "Picked device '" << mDeviceProfile.props.deviceName
+                     << "' (" << TriDevicePolicyName(mSettings.devicePolicy)
+                     << " policy)";
+    }
+
+    mInitSteps.Mark("physical device");
 
-        TriLogInfo() << "Number of suitable Vulkan-enabled devices: "
-                     << suitableDevices.size();
+    bool dynamicRenderingExtension = false;
+    mUseDynamicRendering =
+        mSettings.dynamicRendering &&
+        QueryDynamicRendering(mDeviceProfile, dynamicRenderingExtension);
 
-        mPhysicalDevice = suitableDevices[0].second;
+    if (mUseDynamicRendering && dynamicRenderingExtension)
+    {
+        reqDeviceExtensions.emplace_back(
+            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
     }
 
     // Create Vulkan logical device & queues
@@ -255,7 +375,7 @@ void TriApp::Init()
     {
         mQueueFamilyIndices = FindQueueFamilies();
 
-        if (!mQueueFamilyIndices.IsComplete())
+        if (!mQueueFamilyIndices.IsComplete(!mSettings.headless))
         {
             TriLogError() << "Incomplete queue family index list";
             Finalize();
@@ -263,8 +383,13 @@ void TriApp::Init()
         }
 
         std::set<uint32_t> uniqueQueueIndices{
-            *mQueueFamilyIndices.graphicsFamily,
-            *mQueueFamilyIndices.presentFamily};
+            *mQueueFamilyIndices.graphicsFamily};
+        if (mQueueFamilyIndices.presentFamily.has_value())
+        {
+            uniqueQueueIndices.insert(*mQueueFamilyIndices.presentFamily);
+        }
+        uniqueQueueIndices.insert(*mQueueFamilyIndices.transferFamily);
+        uniqueQueueIndices.insert(*mQueueFamilyIndices.computeFamily);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
@@ -281,13 +406,17 @@ void TriApp::Init()
             queueCreateInfos.emplace_back(std::move(queueCreateInfo));
         }
 
-        TriLogInfo() << "Number of unique queues (graphics + present): "
+        TriLogInfo() << "Number of unique queues (graphics, present, transfer "
+                        "& compute): "
                      << queueCreateInfos.size();
 
-        /* TODO(42): Query used features at RateDeviceSuitability and use them
-           over here - right now we don't use any feats
+        /* Features come from the selector's device profile and are only
+           enabled once something uses them; so far that is the GPU profiler
         */
         VkPhysicalDeviceFeatures deviceFeats{};
+        deviceFeats.pipelineStatisticsQuery =
+            mSettings.gpuProfiling &&
+            mDeviceProfile.feats.pipelineStatisticsQuery;
 
         // Create device
         VkDeviceCreateInfo createInfo{};
@@ -299,10 +428,19 @@ void TriApp::Init()
         createInfo.enabledExtensionCount = reqDeviceExtensions.size();
         createInfo.ppEnabledExtensionNames = reqDeviceExtensions.data();
 
+        VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeats{};
+        dynamicRenderingFeats.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamicRenderingFeats.pNext = nullptr;
+        dynamicRenderingFeats.dynamicRendering = VK_TRUE;
+
+        if (mUseDynamicRendering)
+            createInfo.pNext = &dynamicRenderingFeats;
+
         // We are NOT going to enable validation layers for this one
 
-        VkResult result =
-            vkCreateDevice(mPhysicalDevice, &createInfo, nullptr, &mDevice);
+        VkResult result = vkCreateDevice(mPhysicalDevice, &createInfo,
+                                         mHostAllocator.Callbacks(), &mDevice);
 
         if (result != VK_SUCCESS)
         {
@@ -313,130 +451,75 @@ void TriApp::Init()
 
         vkGetDeviceQueue(mDevice, *mQueueFamilyIndices.graphicsFamily, 0,
                          &mGraphicsQueue);
-        vkGetDeviceQueue(mDevice, *mQueueFamilyIndices.presentFamily, 0,
-                         &mPresentQueue);
-
-        TriLogInfo() << "Device created: " << mDevice
-                     << ", with graphics queue: " << mGraphicsQueue
-                     << ", present queue: " << mPresentQueue;
-    }
-
-    if (!mSwapChain)
-    {
-        // TODO(42): Do something about swap chains
-
-        SwapChainSupportDetails details =
-            QuerySwapChainSupport(mPhysicalDevice);
-
-        mSurfaceFormat = ChooseSwapSurfaceFormat(details.formats);
-        mPresentMode = ChooseSwapPresentMode(details.presentModes);
-        mSwapExtent = ChooseSwapExtent(details.capabilities);
-
-        const VkSurfaceCapabilitiesKHR &capabilities = details.capabilities;
-
-        // How many images before the producer queue becomes full
-        uint32_t imageCount = capabilities.minImageCount;
-        uint32_t maxImageCount = capabilities.maxImageCount;
-        if (maxImageCount != 0)
-        {
-            imageCount = glm::clamp(imageCount, imageCount + 1, maxImageCount);
-        }
-
-        VkSwapchainCreateInfoKHR createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-        createInfo.pNext = nullptr;
-        createInfo.surface = mSurface;
-        createInfo.minImageCount = imageCount;
-        createInfo.imageFormat = mSurfaceFormat.format;
-        createInfo.imageColorSpace = mSurfaceFormat.colorSpace;
-        createInfo.imageExtent = mSwapExtent;
-        createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-        uint32_t queueIndicies[2] = {*mQueueFamilyIndices.graphicsFamily,
-                                     *mQueueFamilyIndices.presentFamily};
-
-        if (queueIndicies[0] == queueIndicies[1])
-        {
-            createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            createInfo.queueFamilyIndexCount = 1;
-        }
-        else
+        if (mQueueFamilyIndices.presentFamily.has_value())
         {
-            createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-            createInfo.queueFamilyIndexCount = 2;
+            vkGetDeviceQueue(mDevice, *mQueueFamilyIndices.presentFamily, 0,
+                             &mPresentQueue);
         }
 
-        createInfo.pQueueFamilyIndices = queueIndicies;
-
-        // No transforms, thank you very much
-        createInfo.preTransform = capabilities.currentTransform;
-
-        // Do not blend
-        createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-
-        createInfo.presentMode = mPresentMode;
-        createInfo.clipped = true;
-
-        createInfo.oldSwapchain = nullptr;
-
-        VkResult result =
-            vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain);
+        vkGetDeviceQueue(mDevice, *mQueueFamilyIndices.transferFamily, 0,
+                         &mTransferQueue);
+        vkGetDeviceQueue(mDevice, *mQueueFamilyIndices.computeFamily, 0,
+                         &mComputeQueue);
 
-        if (result != VK_SUCCESS)
+        TriLogInfo() << "Device created: " << mDevice
+                     << ", with graphics queue: " << mGraphicsQueue
+                     << ", present queue: " << mPresentQueue
+                     << ", transfer queue: " << mTransferQueue
+                     << (mQueueFamilyIndices.HasAsyncTransfer() ? " (async)"
+                                                                : "")
+                     << ", compute queue: " << mComputeQueue
+                     << (mQueueFamilyIndices.HasAsyncCompute() ? " (async)"
+                                                               : "");
+
+        mAllocator.Init(mPhysicalDevice, mDevice, mHostAllocator.Callbacks());
+
+        // The per-frame path calls straight into the driver
+        if (!mLibrary.InitDevice(mDevice, !mSettings.headless,
+                                 mUseDynamicRendering,
+                                 dynamicRenderingExtension))
         {
-            TriLogError() << "Failed to create swap chain";
+            TriLogError() << "Failed to resolve device functions";
             Finalize();
             return;
         }
 
-        TriLogInfo() << "Swap chain created: " << mSwapChain;
-
-        // Retrieve swap chain images
-        uint32_t numSwapChainImages = 0;
-        vkGetSwapchainImagesKHR(mDevice, mSwapChain, &numSwapChainImages,
-                                nullptr);
-        mSwapChainImages.resize(numSwapChainImages);
-        vkGetSwapchainImagesKHR(mDevice, mSwapChain, &numSwapChainImages,
-                                mSwapChainImages.data());
-
-        TriLogInfo() << "Number of swap chain images: " << numSwapChainImages;
-    }
-
-    if (mSwapChainImageViews.empty())
-    {
-        mSwapChainImageViews.resize(mSwapChainImages.size());
-
-        for (size_t i = 0; i < mSwapChainImages.size(); i++)
+        if (mUseDynamicRendering)
         {
-            VkImageViewCreateInfo createInfo{};
-            createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            createInfo.pNext = nullptr;
-            createInfo.image = mSwapChainImages[i];
-            createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            createInfo.format = mSurfaceFormat.format;
-            createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            createInfo.subresourceRange.baseMipLevel = 0;
-            createInfo.subresourceRange.levelCount = 1;
-            createInfo.subresourceRange.baseArrayLayer = 0;
-            createInfo.subresourceRange.layerCount = 1;
-
-            VkResult result = vkCreateImageView(mDevice, &createInfo, nullptr,
-                                                &mSwapChainImageViews[i]);
-            if (result != VK_SUCCESS)
+            if (!mLibrary.HasDynamicRendering())
             {
-                TriLogError() << "Failed to create swap chain image view";
-                Finalize();
-                return;
+                TriLogWarning() << "Dynamic rendering entry points missing, "
+                                   "falling back to render passes";
+                mUseDynamicRendering = false;
             }
         }
+
+        TriLogInfo() << "Rendering with "
+                     << (mUseDynamicRendering ? "dynamic rendering"
+                                              : "render passes");
+    }
+
+    mInitSteps.Mark("device");
+
+    /* The render pass & pipelines only depend on the surface format, so it
+       is picked ahead of the swap chain; the pipelines then compile on the
+       builder while the swap chain & the rest are set up
+    */
+    if (mSettings.headless)
+    {
+        // Stand-in for the format a swap chain would provide
+        mSurfaceFormat.format = VK_FORMAT_R8G8B8A8_UNORM;
+        mSurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    }
+    else if (!mSwapChain)
+    {
+        SwapChainSupportDetails details =
+            QuerySwapChainSupport(mPhysicalDevice);
+        mSurfaceFormat = ChooseSwapSurfaceFormat(details.formats);
     }
 
-    if (!mRenderPass)
+    // Dynamic rendering describes its attachments while recording instead
+    if (!mRenderPass && !mUseDynamicRendering)
     {
         // Data side
         VkAttachmentDescription colorAttachment{};
@@ -447,7 +530,10 @@ void TriApp::Init()
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // Offscreen targets are left ready to be copied out
+        colorAttachment.finalLayout = mSettings.headless
+                                          ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                          : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         // One subpass (shader side)
         VkAttachmentReference colorAttachmentRef{};
@@ -466,7 +552,7 @@ void TriApp::Init()
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         dependency.srcAccessMask = 0;
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstStageMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
         VkRenderPassCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -478,8 +564,9 @@ void TriApp::Init()
         createInfo.dependencyCount = 1;
         createInfo.pDependencies = &dependency;
 
-        VkResult result =
-            vkCreateRenderPass(mDevice, &createInfo, nullptr, &mRenderPass);
+        VkResult result = vkCreateRenderPass(mDevice, &createInfo,
+                                             mHostAllocator.Callbacks(),
+                                             &mRenderPass);
         if (result != VK_SUCCESS)
         {
             TriLogError() << "Failed to create render pass";
@@ -488,6 +575,23 @@ void TriApp::Init()
         }
     }
 
+    mInitSteps.Mark("render pass");
+
+    // A missing cache only costs compile time, so failure is not fatal
+    if (!mPipelineCache.Get() &&
+        mPipelineCache.Init(mPhysicalDevice, mDevice,
+                            mHostAllocator.Callbacks(),
+                            mSettings.pipelineCachePath) != VK_SUCCESS)
+    {
+        TriLogWarning() << "Continuing without a pipeline cache";
+    }
+
+    // The builder takes the preloaded shaders
+    if (mShaderPreload.valid())
+        mShaderPreload.wait();
+
+    mInitSteps.Mark("shader preload & pipeline cache");
+
     /* This is gonna be REALLY long so I am breaking it off into its own
        function
     */
@@ -500,40 +604,59 @@ void TriApp::Init()
         return;
     }
 
-    if (mFramebuffers.empty())
+    mInitSteps.Mark("pipeline submission");
+
+    if (mSettings.headless)
     {
-        mFramebuffers.resize(mSwapChainImageViews.size());
-        for (size_t i = 0; i < mSwapChainImageViews.size(); i++)
+        if (mSwapChainImages.empty())
         {
-            // Create a framebuffer for each swap chain image view
-            VkImageView attachments[] = {mSwapChainImageViews[i]};
-
-            VkFramebufferCreateInfo createInfo{};
-            createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            createInfo.pNext = nullptr;
-            createInfo.renderPass = mRenderPass;
-            createInfo.attachmentCount = 1;
-            createInfo.pAttachments = attachments;
-            createInfo.width = mSwapExtent.width;
-            createInfo.height = mSwapExtent.height;
-            createInfo.layers = 1;
-
-            VkResult result = vkCreateFramebuffer(mDevice, &createInfo, nullptr,
-                                                  &mFramebuffers[i]);
-
+            VkResult result = InitOffscreenTargets();
             if (result != VK_SUCCESS)
             {
-                TriLogError()
-                    << "Failed during swap chain creation (" << i << ")";
                 Finalize();
                 return;
             }
         }
+    }
+    else if (!mSwapChain)
+    {
+        mPresentMode = ChooseSwapPresentMode(
+            QuerySwapChainSupport(mPhysicalDevice).presentModes);
+
+        VkResult result = InitSwapChain(nullptr);
+        if (result != VK_SUCCESS)
+        {
+            Finalize();
+            return;
+        }
+    }
+
+    mInitSteps.Mark("swap chain");
+
+    if (mSwapChainImageViews.empty())
+    {
+        VkResult result = InitSwapChainImageViews();
+        if (result != VK_SUCCESS)
+        {
+            Finalize();
+            return;
+        }
+    }
+
+    mInitSteps.Mark("image views");
 
-        TriLogInfo() << "Number of framebuffers created: "
-                     << mFramebuffers.size();
+    if (mFramebuffers.empty())
+    {
+        VkResult result = InitFramebuffers();
+        if (result != VK_SUCCESS)
+        {
+            Finalize();
+            return;
+        }
     }
 
+    mInitSteps.Mark("framebuffers");
+
     if (!mCommandPool)
     {
         VkCommandPoolCreateInfo createInfo{};
@@ -542,363 +665,1379 @@ void TriApp::Init()
         createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         createInfo.queueFamilyIndex = *mQueueFamilyIndices.graphicsFamily;
 
-        VkResult result =
-            vkCreateCommandPool(mDevice, &createInfo, nullptr, &mCommandPool);
+        VkResult result = vkCreateCommandPool(mDevice, &createInfo,
+                                              mHostAllocator.Callbacks(),
+                                              &mCommandPool);
         if (result != VK_SUCCESS)
         {
             TriLogError() << "Failed to create command pool";
             Finalize();
             return;
         }
+    }
+
+    if (mFrames.empty())
+    {
+        mFrames.resize(mSettings.framesInFlight, FrameContext{});
+
+        // Allocate one command buffer per frame in flight
+        std::vector<VkCommandBuffer> commandBuffers(mFrames.size());
 
-        // Allocate ONE (1) single command buffer
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.pNext = nullptr;
         allocInfo.commandPool = mCommandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        allocInfo.commandBufferCount = commandBuffers.size();
 
-        result = vkAllocateCommandBuffers(mDevice, &allocInfo, &mCommandBuffer);
+        VkResult result = vkAllocateCommandBuffers(mDevice, &allocInfo,
+                                                   commandBuffers.data());
         if (result != VK_SUCCESS)
         {
-            TriLogError() << "Failed to allocate command buffer";
+            TriLogError() << "Failed to allocate command buffers";
             Finalize();
             return;
         }
-    }
 
-    // Create synchronization objects/entities
-    VkSemaphoreCreateInfo semaCreateInfo{};
-    semaCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    semaCreateInfo.pNext = nullptr;
+        // Create synchronization objects/entities
+        VkSemaphoreCreateInfo semaCreateInfo{};
+        semaCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaCreateInfo.pNext = nullptr;
 
-    if (!mImageAvailableSemaphore)
-    {
-        VkResult result = vkCreateSemaphore(mDevice, &semaCreateInfo, nullptr,
-                                            &mImageAvailableSemaphore);
-        if (result != VK_SUCCESS)
+        // Signaled so that the first wait on each frame returns immediately
+        VkFenceCreateInfo fenceCreateInfo{};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCreateInfo.pNext = nullptr;
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (size_t i = 0; i < mFrames.size(); i++)
         {
-            TriLogError() << "Failed to create image available semaphore";
-            Finalize();
-            return;
+            FrameContext &frame = mFrames[i];
+            frame.commandBuffer = commandBuffers[i];
+
+            result = vkCreateSemaphore(mDevice, &semaCreateInfo,
+                                       mHostAllocator.Callbacks(),
+                                       &frame.imageAvailableSemaphore);
+            if (result != VK_SUCCESS)
+            {
+                TriLogError() << "Failed to create image available semaphore";
+                Finalize();
+                return;
+            }
+
+            result = vkCreateFence(mDevice, &fenceCreateInfo,
+                                   mHostAllocator.Callbacks(),
+                                   &frame.inFlightFence);
+            if (result != VK_SUCCESS)
+            {
+                TriLogError() << "Failed to create in-flight fence";
+                Finalize();
+                return;
+            }
         }
+
+        mCurrentFrame = 0;
+
+        TriLogInfo() << "Number of frames in flight: " << mFrames.size();
+    }
+
+    // Without it the report just lacks the GPU side
+    if (mSettings.gpuProfiling && !mGpuProfiler.IsEnabled() &&
+        mGpuProfiler.Init(&mLibrary, mPhysicalDevice, mDevice,
+                          mHostAllocator.Callbacks(), mFrames.size(),
+                          mDeviceProfile.feats.pipelineStatisticsQuery) !=
+            VK_SUCCESS)
+    {
+        TriLogWarning() << "Continuing without GPU profiling";
     }
-    if (!mRenderFinishedSemaphore)
+
+    mInitSteps.Mark("command buffers & frame sync");
+
+    // Nothing is presented in headless mode
+    if (mRenderFinishedSemaphores.empty() && !mSettings.headless)
     {
-        VkResult result = vkCreateSemaphore(mDevice, &semaCreateInfo, nullptr,
-                                            &mRenderFinishedSemaphore);
+        VkResult result = InitRenderFinishedSemaphores();
         if (result != VK_SUCCESS)
         {
-            TriLogError() << "Failed to create render finished semaphore";
             Finalize();
             return;
         }
     }
-    if (!mInFlightFence)
+
+    if (!mVertexBuffer.buffer)
     {
-        VkFenceCreateInfo fenceCreateInfo{};
-        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCreateInfo.pNext = nullptr;
-        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    
-        VkResult result =
-            vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &mInFlightFence);
+        VkResult result = InitGeometry();
         if (result != VK_SUCCESS)
         {
-            TriLogError() << "Failed to create in-flight fence";
+            TriLogError() << "Failed to upload geometry";
             Finalize();
             return;
         }
     }
+
+    mInitSteps.Mark("geometry");
+
+    TriLogInfo() << "Init took " << mInitSteps.TotalMs() << " ms";
+    for (const auto &step : mInitSteps.GetSteps())
+    {
+        TriLogInfo() << "  " << step.first << ": " << step.second << " ms";
+    }
+
+    // Traces the first frames, pipeline wait included
+    if (mSettings.cpuTraceFrames != 0 && TriCpuTraceStart())
+        mCpuTraceEndFrame = mSettings.cpuTraceFrames;
 }
 
-VkResult TriApp::InitGraphicsPipeline()
+VkResult TriApp::InitGeometry()
 {
-    std::optional<std::vector<char>> vertexShaderCode =
-        ReadBinaryFile("Shaders/triangle.vert.svc");
-    std::optional<std::vector<char>> fragmentShaderCode =
-        ReadBinaryFile("Shaders/triangle.frag.svc");
-
-    if (!vertexShaderCode.has_value() || !fragmentShaderCode.has_value())
-    {
-        TriLogError() << "Failed to create vertex/fragment shader(s)";
-        return VK_RESULT_MAX_ENUM;
-    }
-
-    VkShaderModule vertexShader = CreateShaderModule(*vertexShaderCode);
-    VkShaderModule fragmentShader = CreateShaderModule(*fragmentShaderCode);
-
-    // Vertex shader create info
-    VkPipelineShaderStageCreateInfo vertexShaderCreateInfo{};
-    vertexShaderCreateInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertexShaderCreateInfo.pNext = nullptr;
-    vertexShaderCreateInfo.module = vertexShader;
-    vertexShaderCreateInfo.pName = "main";
-
-    // Fragment shader create info
-    VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo{};
-    fragmentShaderCreateInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragmentShaderCreateInfo.pNext = nullptr;
-    fragmentShaderCreateInfo.module = fragmentShader;
-    fragmentShaderCreateInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo stages[] = {vertexShaderCreateInfo,
-                                                fragmentShaderCreateInfo};
-
-    // Dynamic states
-    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
-                                                 VK_DYNAMIC_STATE_SCISSOR};
-
-    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateCreateInfo.pNext = nullptr;
-    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-    // Pipeline vertex input state
-    VkPipelineVertexInputStateCreateInfo vertexCreateInfo{};
-    vertexCreateInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexCreateInfo.pNext = nullptr;
-    vertexCreateInfo.vertexBindingDescriptionCount = 0;
-    vertexCreateInfo.pVertexBindingDescriptions = nullptr;
-    vertexCreateInfo.vertexAttributeDescriptionCount = 0;
-    vertexCreateInfo.pVertexAttributeDescriptions = nullptr;
-
-    // Input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.pNext = nullptr;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    // Viewport & scissor (if fixed)
-    // VkViewport viewport{}; ...
-
-    VkPipelineViewportStateCreateInfo viewportCreateInfo{};
-    viewportCreateInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportCreateInfo.pNext = nullptr;
-    viewportCreateInfo.viewportCount = 1;
-    // viewportCreateInfo.pViewports = &viewport;
-    viewportCreateInfo.scissorCount = 1;
-    // viewportCreateInfo.pScissors = &scissor;
-
-    // Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.pNext = nullptr;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0f;
-    rasterizer.depthBiasClamp = 0.0f;
-    rasterizer.depthBiasSlopeFactor = 0.0f;
-
-    // Multisampling: disabled for now
-    VkPipelineMultisampleStateCreateInfo multiSample{};
-    multiSample.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multiSample.pNext = nullptr;
-    multiSample.sampleShadingEnable = VK_FALSE;
-    multiSample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multiSample.minSampleShading = 1.0f;
-    multiSample.pSampleMask = nullptr;
-    multiSample.alphaToCoverageEnable = VK_FALSE;
-    multiSample.alphaToOneEnable = VK_FALSE;
-
-    // Color blending
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask =
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-    // Basically same as above
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.pNext = nullptr;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
+    VkResult result =
+        mUploader.Init(&mAllocator, mTransferQueue,
+                       *mQueueFamilyIndices.transferFamily, mGraphicsQueue,
+                       *mQueueFamilyIndices.graphicsFamily);
+    if (result != VK_SUCCESS)
+        return result;
 
-    VkPipelineLayoutCreateInfo layoutCreateInfo{};
-    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layoutCreateInfo.pNext = nullptr;
-    layoutCreateInfo.setLayoutCount = 0;
-    layoutCreateInfo.pSetLayouts = nullptr;
-    layoutCreateInfo.pushConstantRangeCount = 0;
-    layoutCreateInfo.pPushConstantRanges = nullptr;
+    TriMeshData mesh;
+    mesh.vertices = {{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+                     {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
+                     {{0.0f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
+    mesh.indices = {0, 1, 2};
 
-    if (!mPipelineLayout)
-    {
-        VkResult result = vkCreatePipelineLayout(mDevice, &layoutCreateInfo,
-                                                 nullptr, &mPipelineLayout);
+    result = mUploader.Upload(mesh.vertices.data(),
+                              mesh.vertices.size() * sizeof(TriVertex),
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mVertexBuffer);
+    if (result != VK_SUCCESS)
+        return result;
 
-        if (result != VK_SUCCESS)
-        {
-            TriLogError() << "Failed to create VkPipelineLayout";
-        }
-    }
+    result = mUploader.Upload(mesh.indices.data(),
+                              mesh.indices.size() * sizeof(uint32_t),
+                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mIndexBuffer);
+    if (result != VK_SUCCESS)
+        return result;
 
-    if (!mGraphicsPipeline)
-    {
-        VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
-        pipelineCreateInfo.sType =
-            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineCreateInfo.pNext = nullptr;
-        pipelineCreateInfo.stageCount = 2;
-        pipelineCreateInfo.pStages = stages;
-        pipelineCreateInfo.pVertexInputState = &vertexCreateInfo;
-        pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-        pipelineCreateInfo.pViewportState = &viewportCreateInfo;
-        pipelineCreateInfo.pRasterizationState = &rasterizer;
-        pipelineCreateInfo.pMultisampleState = &multiSample;
-        pipelineCreateInfo.pDepthStencilState = nullptr;
-        pipelineCreateInfo.pColorBlendState = &colorBlending;
-        pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-        pipelineCreateInfo.layout = mPipelineLayout;
-        pipelineCreateInfo.renderPass = mRenderPass;
-        pipelineCreateInfo.subpass = 0;
-        pipelineCreateInfo.basePipelineHandle = nullptr;
-        pipelineCreateInfo.basePipelineIndex = -1;
+    // Both copies go out in a single submission; frames submitted later are
+    // ordered after it, so there is no need to wait here
+    result = mUploader.Flush();
+    if (result != VK_SUCCESS)
+        return result;
 
-        VkResult result =
-            vkCreateGraphicsPipelines(mDevice, nullptr, 1, &pipelineCreateInfo,
-                                      nullptr, &mGraphicsPipeline);
+    mIndexCount = static_cast<uint32_t>(mesh.indices.size());
+
+    mMeshRadius = 0.0f;
+    for (const TriVertex &vertex : mesh.vertices)
+        mMeshRadius = std::max(mMeshRadius, glm::length(vertex.position));
+
+    TriLogInfo() << "Uploaded mesh: " << mesh.vertices.size()
+                 << " vertices, " << mIndexCount << " indices";
+
+    /* Instance data lives in host-visible memory, one buffer per frame in
+       flight so that the CPU writes a slot only after its fence was waited
+       on. Device-local staging would double the bandwidth for data that is
+       rewritten every frame anyway.
+    */
+    mStressScene.Generate(mSettings.instances, mSettings.sceneExtent);
+
+    VkDeviceSize instanceBytes = mStressScene.GetCount() * sizeof(TriInstance);
+
+    // The culling pass reads instances as a storage buffer instead
+    VkBufferUsageFlags instanceUsage = mSettings.gpuCulling
+                                           ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                           : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+    for (FrameContext &frame : mFrames)
+    {
+        result = CreateBuffer(mAllocator, instanceBytes, instanceUsage,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              TriAllocFreeList, frame.instanceBuffer);
         if (result != VK_SUCCESS)
-        {
-            TriLogError() << "Failed to create VkGraphicsPipeline";
-        }
+            return result;
+
+        // Static scenes are written once, here
+        mStressScene.Write(static_cast<TriInstance *>(
+                               frame.instanceBuffer.allocation.mapped),
+                           0.0);
     }
 
-    vkDestroyShaderModule(mDevice, vertexShader, nullptr);
-    vkDestroyShaderModule(mDevice, fragmentShader, nullptr);
+    TriLogInfo() << "Drawing " << mStressScene.GetCount() << " instance(s), "
+                 << GetPrimitivesPerFrame() << " triangles per frame"
+                 << (mSettings.staticInstances ? " (static)" : "");
 
-    TriLogInfo() << "Graphics pipeline creation done: " << mGraphicsPipeline;
+    if (mSettings.gpuCulling)
+    {
+        TriLogInfo() << "Culling should keep "
+                     << mStressScene.CountVisible(mMeshRadius) << " of "
+                     << mStressScene.GetCount() << " instance(s)";
+
+        return InitCullResources();
+    }
 
     return VK_SUCCESS;
 }
 
-void TriApp::Loop()
+VkResult TriApp::InitCullResources()
 {
-    while (mpWindow && !glfwWindowShouldClose(mpWindow))
-    {
-        glfwPollEvents();
-        RenderFrame();
-    }
-}
+    VkDeviceSize instanceBytes = mStressScene.GetCount() * sizeof(TriInstance);
 
-void TriApp::Finalize()
-{
-    if (mDevice)
-        vkDeviceWaitIdle(mDevice);
-    
-    if (mImageAvailableSemaphore)
-    {
-        vkDestroySemaphore(mDevice, mImageAvailableSemaphore, nullptr);
-        mImageAvailableSemaphore = nullptr;
-    }
-    if (mRenderFinishedSemaphore)
+    for (FrameContext &frame : mFrames)
     {
-        vkDestroySemaphore(mDevice, mRenderFinishedSemaphore, nullptr);
-        mRenderFinishedSemaphore = nullptr;
+        VkResult result =
+            CreateBuffer(mAllocator, instanceBytes,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TriAllocFreeList,
+                         frame.visibleInstanceBuffer);
+        if (result != VK_SUCCESS)
+            return result;
+
+        result = CreateBuffer(mAllocator, sizeof(VkDrawIndexedIndirectCommand),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              TriAllocFreeList, frame.drawBuffer);
+        if (result != VK_SUCCESS)
+            return result;
     }
-    if (mInFlightFence)
+
+    uint32_t frameCount = static_cast<uint32_t>(mFrames.size());
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3 * frameCount;
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.pNext = nullptr;
+    poolCreateInfo.maxSets = frameCount;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+
+    VkResult result = vkCreateDescriptorPool(mDevice, &poolCreateInfo,
+                                             mHostAllocator.Callbacks(),
+                                             &mCullDescriptorPool);
+    if (result != VK_SUCCESS)
     {
-        vkDestroyFence(mDevice, mInFlightFence, nullptr);
-        mInFlightFence = nullptr;
+        TriLogError() << "Failed to create culling descriptor pool";
+        return result;
     }
 
-    if (mCommandPool)
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount,
+                                                  mCullDescriptorSetLayout);
+    std::vector<VkDescriptorSet> sets(frameCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = mCullDescriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = setLayouts.data();
+
+    result = vkAllocateDescriptorSets(mDevice, &allocInfo, sets.data());
+    if (result != VK_SUCCESS)
     {
-        vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
-        mCommandBuffer = nullptr;
-        mCommandPool = nullptr;
+        TriLogError() << "Failed to allocate culling descriptor sets";
+        return result;
     }
 
-    if (!mFramebuffers.empty())
+    for (uint32_t i = 0; i < frameCount; i++)
     {
-        for (VkFramebuffer framebuffer : mFramebuffers)
+        FrameContext &frame = mFrames[i];
+        frame.cullDescriptorSet = sets[i];
+
+        VkDescriptorBufferInfo bufferInfos[3]{};
+        bufferInfos[0].buffer = frame.instanceBuffer.buffer;
+        bufferInfos[0].range = VK_WHOLE_SIZE;
+        bufferInfos[1].buffer = frame.visibleInstanceBuffer.buffer;
+        bufferInfos[1].range = VK_WHOLE_SIZE;
+        bufferInfos[2].buffer = frame.drawBuffer.buffer;
+        bufferInfos[2].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writes[3]{};
+        for (uint32_t binding = 0; binding < 3; binding++)
         {
-            vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].pNext = nullptr;
+            writes[binding].dstSet = frame.cullDescriptorSet;
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
         }
-        mFramebuffers.clear();
+
+        vkUpdateDescriptorSets(mDevice, 3, writes, 0, nullptr);
     }
 
-    if (mRenderPass)
+    if (!mQueueFamilyIndices.HasAsyncCompute())
+        return VK_SUCCESS;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.pNext = nullptr;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = *mQueueFamilyIndices.computeFamily;
+
+    result = vkCreateCommandPool(mDevice, &poolInfo, mHostAllocator.Callbacks(),
+                                 &mComputeCommandPool);
+    if (result != VK_SUCCESS)
     {
-        vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
-        mRenderPass = nullptr;
+        TriLogError() << "Failed to create compute command pool";
+        return result;
+    }
+
+    std::vector<VkCommandBuffer> commandBuffers(frameCount);
+
+    VkCommandBufferAllocateInfo commandAllocInfo{};
+    commandAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandAllocInfo.pNext = nullptr;
+    commandAllocInfo.commandPool = mComputeCommandPool;
+    commandAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandAllocInfo.commandBufferCount = frameCount;
+
+    result = vkAllocateCommandBuffers(mDevice, &commandAllocInfo,
+                                      commandBuffers.data());
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to allocate compute command buffers";
+        return result;
+    }
+
+    VkSemaphoreCreateInfo semaCreateInfo{};
+    semaCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaCreateInfo.pNext = nullptr;
+
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        FrameContext &frame = mFrames[i];
+        frame.computeCommandBuffer = commandBuffers[i];
+
+        result = vkCreateSemaphore(mDevice, &semaCreateInfo,
+                                   mHostAllocator.Callbacks(),
+                                   &frame.cullFinishedSemaphore);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to create cull finished semaphore";
+            return result;
+        }
+    }
+
+    TriLogInfo() << "Culling on the async compute queue";
+
+    return VK_SUCCESS;
+}
+
+double TriApp::UpdateInstances(FrameContext &frame)
+{
+    if (mSettings.staticInstances)
+        return 0.0;
+
+    TRI_CPU_SCOPE("UpdateInstances");
+    TriClock::time_point updateStart = TriClock::now();
+
+    double time = std::chrono::duration<double>(updateStart - mInitStartTime)
+                      .count();
+    mStressScene.Write(
+        static_cast<TriInstance *>(frame.instanceBuffer.allocation.mapped),
+        time);
+
+    return TriElapsedMs(updateStart);
+}
+
+void TriApp::ReadGpuTimings(uint32_t slot)
+{
+    TRI_CPU_SCOPE("ReadGpuTimings");
+
+    if (!mGpuProfiler.BeginFrame(slot))
+        return;
+
+    const TriGpuScopeResult *frameScope =
+        mGpuProfiler.FindResult(kGpuFrameScope);
+    const TriGpuScopeResult *cullScope = mGpuProfiler.FindResult(kGpuCullScope);
+    const TriGpuScopeResult *drawScope = mGpuProfiler.FindResult(kGpuDrawScope);
+
+    mLastFrameTimings.gpuTimed = frameScope != nullptr;
+    mLastFrameTimings.gpuFrameMs = frameScope ? frameScope->gpuMs : 0.0;
+    mLastFrameTimings.gpuCullMs = cullScope ? cullScope->gpuMs : 0.0;
+    mLastFrameTimings.gpuDrawMs = drawScope ? drawScope->gpuMs : 0.0;
+}
+
+uint64_t TriApp::GetPrimitivesPerFrame() const
+{
+    return mIndexCount / 3 * mStressScene.GetCount();
+}
+
+VkResult TriApp::InitGraphicsPipeline()
+{
+    VkPipelineLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = nullptr;
+    layoutCreateInfo.setLayoutCount = 0;
+    layoutCreateInfo.pSetLayouts = nullptr;
+    layoutCreateInfo.pushConstantRangeCount = 0;
+    layoutCreateInfo.pPushConstantRanges = nullptr;
+
+    if (!mPipelineLayout)
+    {
+        VkResult result = vkCreatePipelineLayout(mDevice, &layoutCreateInfo,
+                                                 mHostAllocator.Callbacks(),
+                                                 &mPipelineLayout);
+
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to create VkPipelineLayout";
+            return result;
+        }
+    }
+
+    mPipelineBuilder.Init(mDevice, mPipelineCache.Get(),
+                          mHostAllocator.Callbacks(),
+                          mSettings.pipelineThreads);
+    mPipelineVariants.Init(mDevice, &mPipelineBuilder);
+
+    if (!mGraphicsPipeline && !mGraphicsPipelineFuture.valid())
+    {
+        mGraphicsPipelineDesc = TriPipelineDesc();
+        mGraphicsPipelineDesc.name = "triangle";
+        mGraphicsPipelineDesc.vertexShader = kVertexShader;
+        mGraphicsPipelineDesc.fragmentShader = kFragmentShader;
+        mGraphicsPipelineDesc.layout = mPipelineLayout;
+        mGraphicsPipelineDesc.renderPass = mRenderPass;
+        if (mUseDynamicRendering)
+            mGraphicsPipelineDesc.colorFormats = {mSurfaceFormat.format};
+        mGraphicsPipelineDesc.vertexBindings = TriVertex::GetBindings();
+        mGraphicsPipelineDesc.vertexAttributes = TriVertex::GetAttributes();
+
+        // Binding 1 streams per-instance transforms & colors
+        for (const VkVertexInputBindingDescription &binding :
+             TriInstance::GetBindings())
+            mGraphicsPipelineDesc.vertexBindings.emplace_back(binding);
+
+        for (const VkVertexInputAttributeDescription &attribute :
+             TriInstance::GetAttributes())
+            mGraphicsPipelineDesc.vertexAttributes.emplace_back(attribute);
+
+        // Compiles while the rest of Init() runs; picked up by the first frame
+        mGraphicsPipelineFuture =
+            mPipelineVariants.Request(mGraphicsPipelineDesc);
+    }
+
+    if (mSettings.gpuCulling && !mCullPipeline &&
+        !mCullPipelineFuture.valid())
+    {
+        VkResult result = InitCullPipeline();
+        if (result != VK_SUCCESS)
+            return result;
+    }
+
+    if (mSettings.hotReload && !mShaderWatcher.IsWatching())
+    {
+        // Not fatal: rendering works the same, just without reloads
+        mShaderWatcher.Init(TRI_SHADER_SOURCE_DIR);
     }
 
+    return VK_SUCCESS;
+}
+
+VkResult TriApp::InitCullPipeline()
+{
+    // Binding 0: instances, 1: visible instances, 2: indirect draw
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t binding = 0; binding < 3; binding++)
+    {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo{};
+    setLayoutCreateInfo.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutCreateInfo.pNext = nullptr;
+    setLayoutCreateInfo.bindingCount = 3;
+    setLayoutCreateInfo.pBindings = bindings;
+
+    VkResult result = vkCreateDescriptorSetLayout(mDevice, &setLayoutCreateInfo,
+                                                  mHostAllocator.Callbacks(),
+                                                  &mCullDescriptorSetLayout);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create culling descriptor set layout";
+        return result;
+    }
+
+    // Instance count & mesh bounding radius (see Shaders/cull.comp)
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t) + sizeof(float);
+
+    VkPipelineLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = nullptr;
+    layoutCreateInfo.setLayoutCount = 1;
+    layoutCreateInfo.pSetLayouts = &mCullDescriptorSetLayout;
+    layoutCreateInfo.pushConstantRangeCount = 1;
+    layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(mDevice, &layoutCreateInfo,
+                                    mHostAllocator.Callbacks(),
+                                    &mCullPipelineLayout);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create culling VkPipelineLayout";
+        return result;
+    }
+
+    mCullPipelineFuture =
+        mPipelineBuilder.BuildCompute(kCullShader, mCullPipelineLayout);
+
+    return VK_SUCCESS;
+}
+
+bool TriApp::WaitForGraphicsPipeline()
+{
+    TRI_CPU_SCOPE("WaitForGraphicsPipeline");
+
+    if (mCullPipelineFuture.valid())
+    {
+        mCullPipeline = mCullPipelineFuture.get();
+
+        if (!mCullPipeline)
+            TriLogError() << "Culling pipeline compilation failed";
+    }
+
+    if (mSettings.gpuCulling && !mCullPipeline)
+        return false;
+
     if (mGraphicsPipeline)
+        return true;
+
+    if (!mGraphicsPipelineFuture.valid())
+        return false;
+
+    TriClock::time_point waitStart = TriClock::now();
+    mGraphicsPipeline = mGraphicsPipelineFuture.get();
+    mGraphicsPipelineFuture = std::shared_future<VkPipeline>();
+    mPipelineWaitMs = TriElapsedMs(waitStart);
+
+    if (!mGraphicsPipeline)
+    {
+        TriLogError() << "Graphics pipeline compilation failed";
+        return false;
+    }
+
+    TriLogInfo() << "Graphics pipeline creation done: " << mGraphicsPipeline;
+    return true;
+}
+
+void TriApp::PollShaderReload()
+{
+    if (!mShaderWatcher.IsWatching())
+        return;
+
+    TRI_CPU_SCOPE("PollShaderReload");
+
+    for (const std::string &name : mShaderWatcher.Poll())
+    {
+        if ((name == mGraphicsPipelineDesc.vertexShader ||
+             name == mGraphicsPipelineDesc.fragmentShader) &&
+            std::find(mChangedShaders.begin(), mChangedShaders.end(), name) ==
+                mChangedShaders.end())
+        {
+            mChangedShaders.emplace_back(name);
+        }
+    }
+
+    if (mReloadPipelineFuture.valid())
+    {
+        // Never stall the frame on a rebuild
+        if (mReloadPipelineFuture.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+        {
+            return;
+        }
+
+        VkPipeline pipeline = mReloadPipelineFuture.get();
+
+        if (pipeline)
+        {
+            // Frames before this one were recorded with the old pipeline
+            VkPipeline previous =
+                mPipelineVariants.Replace(mGraphicsPipelineDesc, pipeline);
+            mRetiredPipelines.push_back({previous, mFrameNumber});
+            mGraphicsPipeline = pipeline;
+            TriLogInfo() << "Hot reloaded pipeline "
+                         << mGraphicsPipelineDesc.name;
+        }
+        else
+        {
+            TriLogWarning() << "Hot reload of " << mGraphicsPipelineDesc.name
+                            << " failed, keeping the previous pipeline";
+        }
+    }
+
+    // Changes that arrived during the previous rebuild start a new one
+    if (!mChangedShaders.empty())
+    {
+        TriLogInfo() << "Shader change detected, rebuilding "
+                     << mGraphicsPipelineDesc.name;
+        mReloadPipelineFuture =
+            mPipelineBuilder.Rebuild(mGraphicsPipelineDesc, mChangedShaders);
+        mChangedShaders.clear();
+    }
+}
+
+VkResult TriApp::InitSwapChain(VkSwapchainKHR oldSwapChain)
+{
+    SwapChainSupportDetails details = QuerySwapChainSupport(mPhysicalDevice);
+
+    /* The render pass & pipeline are built against the surface format, so it
+       is chosen once in Init() and kept across swap chain recreation; so is
+       the present mode
+    */
+    mSwapExtent = ChooseSwapExtent(details.capabilities);
+
+    const VkSurfaceCapabilitiesKHR &capabilities = details.capabilities;
+
+    // How many images before the producer queue becomes full
+    uint32_t imageCount = capabilities.minImageCount;
+    uint32_t maxImageCount = capabilities.maxImageCount;
+    if (maxImageCount != 0)
+    {
+        imageCount = glm::clamp(imageCount, imageCount + 1, maxImageCount);
+    }
+
+    VkSwapchainCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.pNext = nullptr;
+    createInfo.surface = mSurface;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = mSurfaceFormat.format;
+    createInfo.imageColorSpace = mSurfaceFormat.colorSpace;
+    createInfo.imageExtent = mSwapExtent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    uint32_t queueIndicies[2] = {*mQueueFamilyIndices.graphicsFamily,
+                                 *mQueueFamilyIndices.presentFamily};
+
+    if (queueIndicies[0] == queueIndicies[1])
+    {
+        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.queueFamilyIndexCount = 1;
+    }
+    else
+    {
+        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = 2;
+    }
+
+    createInfo.pQueueFamilyIndices = queueIndicies;
+
+    // No transforms, thank you very much
+    createInfo.preTransform = capabilities.currentTransform;
+
+    // Do not blend
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+    createInfo.presentMode = mPresentMode;
+    createInfo.clipped = true;
+
+    // Lets the driver hand over resources from the swap chain being replaced
+    createInfo.oldSwapchain = oldSwapChain;
+
+    VkResult result = vkCreateSwapchainKHR(mDevice, &createInfo,
+                                           mHostAllocator.Callbacks(),
+                                           &mSwapChain);
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create swap chain";
+        mSwapChain = nullptr;
+        return result;
+    }
+
+    TriLogInfo() << "Swap chain created: " << mSwapChain << " ("
+                 << mSwapExtent.width << "x" << mSwapExtent.height << ")";
+
+    // Retrieve swap chain images
+    uint32_t numSwapChainImages = 0;
+    vkGetSwapchainImagesKHR(mDevice, mSwapChain, &numSwapChainImages, nullptr);
+    mSwapChainImages.resize(numSwapChainImages);
+    vkGetSwapchainImagesKHR(mDevice, mSwapChain, &numSwapChainImages,
+                            mSwapChainImages.data());
+
+    TriLogInfo() << "Number of swap chain images: " << numSwapChainImages;
+
+    return VK_SUCCESS;
+}
+
+VkResult TriApp::InitSwapChainImageViews()
+{
+    mSwapChainImageViews.resize(mSwapChainImages.size(), nullptr);
+
+    for (size_t i = 0; i < mSwapChainImages.size(); i++)
+    {
+        VkImageViewCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.image = mSwapChainImages[i];
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        createInfo.format = mSurfaceFormat.format;
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        createInfo.subresourceRange.baseMipLevel = 0;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        VkResult result = vkCreateImageView(mDevice, &createInfo,
+                                            mHostAllocator.Callbacks(),
+                                            &mSwapChainImageViews[i]);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to create swap chain image view";
+            return result;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult TriApp::InitFramebuffers()
+{
+    // Dynamic rendering renders straight into the image views
+    if (mUseDynamicRendering)
+        return VK_SUCCESS;
+
+    mFramebuffers.resize(mSwapChainImageViews.size(), nullptr);
+    for (size_t i = 0; i < mSwapChainImageViews.size(); i++)
+    {
+        // Create a framebuffer for each swap chain image view
+        VkImageView attachments[] = {mSwapChainImageViews[i]};
+
+        VkFramebufferCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.renderPass = mRenderPass;
+        createInfo.attachmentCount = 1;
+        createInfo.pAttachments = attachments;
+        createInfo.width = mSwapExtent.width;
+        createInfo.height = mSwapExtent.height;
+        createInfo.layers = 1;
+
+        VkResult result = vkCreateFramebuffer(mDevice, &createInfo,
+                                              mHostAllocator.Callbacks(),
+                                              &mFramebuffers[i]);
+
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed during framebuffer creation (" << i << ")";
+            return result;
+        }
+    }
+
+    TriLogInfo() << "Number of framebuffers created: " << mFramebuffers.size();
+
+    return VK_SUCCESS;
+}
+
+VkResult TriApp::InitRenderFinishedSemaphores()
+{
+    VkSemaphoreCreateInfo semaCreateInfo{};
+    semaCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaCreateInfo.pNext = nullptr;
+
+    mRenderFinishedSemaphores.resize(mSwapChainImages.size(), nullptr);
+
+    for (VkSemaphore &semaphore : mRenderFinishedSemaphores)
+    {
+        VkResult result = vkCreateSemaphore(mDevice, &semaCreateInfo,
+                                            mHostAllocator.Callbacks(),
+                                            &semaphore);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to create render finished semaphore";
+            return result;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+bool TriApp::RecreateSwapChain()
+{
+    int fbWidth = 0;
+    int fbHeight = 0;
+    glfwGetFramebufferSize(mpWindow, &fbWidth, &fbHeight);
+
+    if (fbWidth == 0 || fbHeight == 0)
+    {
+        // Minimized; nothing to present to until the window comes back
+        glfwWaitEvents();
+        return false;
+    }
+
+    /* Instead of idling the whole device, everything tied to the old swap
+       chain is retired and destroyed once the frames in flight that may
+       still reference it have completed (see ReleaseRetiredSwapChains)
+    */
+    VkSwapchainKHR oldSwapChain = mSwapChain;
+
+    RetiredSwapChain retired{};
+    retired.swapChain = mSwapChain;
+    retired.imageViews = std::move(mSwapChainImageViews);
+    retired.framebuffers = std::move(mFramebuffers);
+    retired.renderFinishedSemaphores = std::move(mRenderFinishedSemaphores);
+    retired.retireFrame = mFrameNumber;
+
+    mSwapChainImageViews.clear();
+    mFramebuffers.clear();
+    mRenderFinishedSemaphores.clear();
+    mSwapChainImages.clear();
+    mSwapChain = nullptr;
+
+    // A failed attempt leaves nothing behind to retire
+    if (retired.swapChain || !retired.imageViews.empty() ||
+        !retired.framebuffers.empty() ||
+        !retired.renderFinishedSemaphores.empty())
+    {
+        mRetiredSwapChains.emplace_back(std::move(retired));
+    }
+
+    VkResult result = InitSwapChain(oldSwapChain);
+    if (result == VK_SUCCESS)
+        result = InitSwapChainImageViews();
+    if (result == VK_SUCCESS)
+        result = InitFramebuffers();
+    if (result == VK_SUCCESS)
+        result = InitRenderFinishedSemaphores();
+
+    if (result != VK_SUCCESS)
+    {
+        OnFrameError(result, "recreate the swap chain");
+
+        /* The old swap chain is retired even if its successor could not be
+           created, so it can no longer be handed over; and the surface only
+           takes a fresh one once every old chain is gone. Failures are rare,
+           so wait for the frames in flight rather than track them
+        */
+        vkDeviceWaitIdle(mDevice);
+        ReleaseRetiredSwapChains(true);
+        return false;
+    }
+
+    mSwapChainDirty = false;
+
+    return true;
+}
+
+void TriApp::ReleaseRetiredSwapChains(bool force)
+{
+    auto destroyRetired = [&](RetiredSwapChain &retired)
+    {
+        for (VkSemaphore semaphore : retired.renderFinishedSemaphores)
+        {
+            if (semaphore)
+                vkDestroySemaphore(mDevice, semaphore,
+                                   mHostAllocator.Callbacks());
+        }
+        for (VkFramebuffer framebuffer : retired.framebuffers)
+        {
+            if (framebuffer)
+                vkDestroyFramebuffer(mDevice, framebuffer,
+                                     mHostAllocator.Callbacks());
+        }
+        for (VkImageView imageView : retired.imageViews)
+        {
+            if (imageView)
+                vkDestroyImageView(mDevice, imageView,
+                                   mHostAllocator.Callbacks());
+        }
+        if (retired.swapChain)
+            vkDestroySwapchainKHR(mDevice, retired.swapChain,
+                                  mHostAllocator.Callbacks());
+    };
+
+    /* Waiting on the fence of frame N guarantees that frame N - framesInFlight
+       completed. Everything submitted before retireFrame has therefore
+       completed once frame (retireFrame + framesInFlight - 1) waited on its
+       fence.
+    */
+    auto it = mRetiredSwapChains.begin();
+    while (it != mRetiredSwapChains.end())
+    {
+        if (force || mFrameNumber + 1 >= it->retireFrame + mFrames.size())
+        {
+            destroyRetired(*it);
+            it = mRetiredSwapChains.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void TriApp::ReleaseRetiredPipelines(bool force)
+{
+    // Same completion rule as ReleaseRetiredSwapChains()
+    auto it = mRetiredPipelines.begin();
+    while (it != mRetiredPipelines.end())
+    {
+        if (force || mFrameNumber + 1 >= it->retireFrame + mFrames.size())
+        {
+            if (it->pipeline)
+                vkDestroyPipeline(mDevice, it->pipeline,
+                                  mHostAllocator.Callbacks());
+            it = mRetiredPipelines.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void TriApp::FramebufferResizeCallback(GLFWwindow *pWindow, int width,
+                                       int height)
+{
+    TriApp *that = static_cast<TriApp *>(glfwGetWindowUserPointer(pWindow));
+
+    if (that)
+    {
+        that->mSwapChainDirty = true;
+    }
+}
+
+void TriApp::KeyCallback(GLFWwindow *pWindow, int key, int scancode,
+                         int action, int mods)
+{
+    TriApp *that = static_cast<TriApp *>(glfwGetWindowUserPointer(pWindow));
+
+    if (that && key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    {
+        that->mCpuTraceToggled = true;
+    }
+}
+
+VkResult TriApp::InitOffscreenTargets()
+{
+    // Stand-in for the extent a swap chain would provide; the format was
+    // already picked by Init()
+    mSwapExtent.width = static_cast<uint32_t>(width);
+    mSwapExtent.height = static_cast<uint32_t>(height);
+
+    // One target per frame in flight; they stand in for swap chain images
+    mSwapChainImages.resize(mSettings.framesInFlight, nullptr);
+    mOffscreenImageAllocations.resize(mSettings.framesInFlight);
+
+    for (size_t i = 0; i < mSwapChainImages.size(); i++)
+    {
+        VkImageCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        createInfo.pNext = nullptr;
+        createInfo.imageType = VK_IMAGE_TYPE_2D;
+        createInfo.format = mSurfaceFormat.format;
+        createInfo.extent.width = mSwapExtent.width;
+        createInfo.extent.height = mSwapExtent.height;
+        createInfo.extent.depth = 1;
+        createInfo.mipLevels = 1;
+        createInfo.arrayLayers = 1;
+        createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        createInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkResult result = vkCreateImage(mDevice, &createInfo,
+                                        mHostAllocator.Callbacks(),
+                                        &mSwapChainImages[i]);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to create offscreen target image";
+            return result;
+        }
+
+        result = mAllocator.AllocateForImage(
+            mSwapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mOffscreenImageAllocations[i]);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to allocate offscreen target memory";
+            return result;
+        }
+    }
+
+    TriLogInfo() << "Number of offscreen targets: " << mSwapChainImages.size()
+                 << " (" << mSwapExtent.width << "x" << mSwapExtent.height
+                 << ")";
+
+    return VK_SUCCESS;
+}
+
+void TriApp::Loop()
+{
+    mAcquireToPresentStat.Reset();
+    mGpuFrameStat.Reset();
+    mCpuBusyStat.Reset();
+    mRenderedFrames = 0;
+    mLoopStartTime = TriClock::now();
+
+    while (IsRunning())
+    {
+        PollEvents();
+        RenderFrame();
+    }
+
+    ReportFrameStats();
+}
+
+void TriApp::PollEvents()
+{
+    if (!mpWindow)
+        return;
+
+    TRI_CPU_SCOPE("glfwPollEvents");
+    glfwPollEvents();
+}
+
+std::string TriApp::GetDeviceName()
+{
+    if (!mPhysicalDevice)
+        return "";
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &props);
+
+    return props.deviceName;
+}
+
+bool TriApp::IsRunning()
+{
+    // Init() failed
+    if (!mDevice || mFrames.empty())
+        return false;
+
+    if (mFatalError)
+        return false;
+
+    // Pipeline compilation failed
+    if (!mGraphicsPipeline && !mGraphicsPipelineFuture.valid())
+        return false;
+
+    if (mSettings.gpuCulling && !mCullPipeline && !mCullPipelineFuture.valid())
+        return false;
+
+    if (mSettings.maxFrames != 0 && mFrameNumber >= mSettings.maxFrames)
+        return false;
+
+    if (mSettings.headless)
+        return true;
+
+    return mpWindow && !glfwWindowShouldClose(mpWindow);
+}
+
+void TriApp::ReportFrameStats()
+{
+    double elapsed = TriElapsedMs(mLoopStartTime) / 1000.0;
+    double fps = elapsed > 0.0 ? mRenderedFrames / elapsed : 0.0;
+
+    TriLogInfo() << "Present mode "
+                 << (mSettings.headless ? "headless"
+                                        : PresentModeName(mPresentMode))
+                 << ": " << mRenderedFrames << " frames in " << elapsed
+                 << "s (" << fps << " FPS, "
+                 << fps * GetPrimitivesPerFrame() << " triangles/s)";
+
+    if (!mSettings.headless)
+    {
+        TriLogInfo() << "Acquire-to-present latency (ms): min "
+                     << mAcquireToPresentStat.Min() << ", mean "
+                     << mAcquireToPresentStat.Mean() << ", max "
+                     << mAcquireToPresentStat.max;
+    }
+
+    // Whichever side takes longer per frame sets the frame rate
+    if (mGpuFrameStat.count != 0)
+    {
+        bool gpuBound = mGpuFrameStat.Mean() >= mCpuBusyStat.Mean();
+
+        TriLogInfo() << "GPU frame time (ms): min " << mGpuFrameStat.Min()
+                     << ", mean " << mGpuFrameStat.Mean() << ", max "
+                     << mGpuFrameStat.max << "; CPU busy mean "
+                     << mCpuBusyStat.Mean() << " ms, "
+                     << (gpuBound ? "GPU" : "CPU") << "-bound";
+    }
+
+    // Per pass, next to the CPU side above
+    for (const TriGpuScopeResult &scope : mGpuProfiler.GetResults())
+    {
+        TriLogInfo() << "GPU " << scope.name << " (last frame): "
+                     << scope.gpuMs << " ms";
+
+        if (!scope.hasStats)
+            continue;
+
+        TriLogInfo() << "GPU " << scope.name << " statistics (last frame): "
+                     << scope.stats.vertexInvocations << " vertex, "
+                     << scope.stats.fragmentInvocations
+                     << " fragment invocations, "
+                     << scope.stats.clippingInvocations << " primitives in & "
+                     << scope.stats.clippingPrimitives << " out of clipping";
+    }
+}
+
+void TriApp::UpdateCpuTrace()
+{
+    bool capturing = TriCpuTraceIsCapturing();
+
+    if (capturing && mCpuTraceEndFrame != 0 &&
+        mFrameNumber >= mCpuTraceEndFrame)
+    {
+        WriteCpuTrace();
+        capturing = false;
+    }
+
+    if (!mCpuTraceToggled)
+        return;
+
+    mCpuTraceToggled = false;
+
+    if (capturing)
+    {
+        WriteCpuTrace();
+    }
+    else if (TriCpuTraceStart())
     {
-        vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
-        mGraphicsPipeline = nullptr;
+        mCpuTraceEndFrame = 0;
+        TriLogInfo() << "CPU trace started, F12 stops it";
+    }
+}
+
+void TriApp::WriteCpuTrace()
+{
+    TriCpuTraceStop();
+    TriCpuTraceWrite(mSettings.cpuTracePath);
+    mCpuTraceEndFrame = 0;
+}
+
+void TriApp::Finalize()
+{
+    // A capture still running when the app stops is written out as is
+    if (TriCpuTraceIsCapturing())
+        WriteCpuTrace();
+
+    if (mDevice)
+        vkDeviceWaitIdle(mDevice);
+
+    ReleaseRetiredSwapChains(true);
+    mSwapChainDirty = false;
+    mFatalError = false;
+
+    /* Pipelines compile on worker threads against the render pass, the
+       pipeline layouts & the shader code; every compile must be joined
+       before any of those are destroyed. Init() failures land here with
+       compiles still in flight; those not started yet are cancelled, so
+       only the ones already running are waited for. A reload still
+       compiling is collected so that it can be destroyed.
+    */
+    mPipelineBuilder.Cancel();
+
+    if (mReloadPipelineFuture.valid())
+    {
+        VkPipeline pipeline = mReloadPipelineFuture.get();
+        if (pipeline)
+            mRetiredPipelines.push_back({pipeline, 0});
+    }
+
+    ReleaseRetiredPipelines(true);
+
+    if (mCullPipelineFuture.valid())
+        mCullPipeline = mCullPipelineFuture.get();
+
+    if (mCullPipeline)
+    {
+        vkDestroyPipeline(mDevice, mCullPipeline, mHostAllocator.Callbacks());
+        mCullPipeline = nullptr;
+    }
+
+    // Owns mGraphicsPipeline, and waits for any pipeline still compiling
+    mPipelineVariants.Finalize();
+    mGraphicsPipelineFuture = std::shared_future<VkPipeline>();
+    mGraphicsPipeline = nullptr;
+
+    mPipelineBuilder.Finalize();
+
+    // Saves the cache to disk before the device goes away
+    mPipelineCache.Finalize();
+
+    // Shaders preloaded but never built are dropped
+    if (mShaderPreload.valid())
+        mShaderPreload.wait();
+    ClearPreloadedShaderCode();
+
+    mShaderWatcher.Finalize();
+    mChangedShaders.clear();
+    mFrameNumber = 0;
+
+    if (!mRenderFinishedSemaphores.empty())
+    {
+        for (VkSemaphore semaphore : mRenderFinishedSemaphores)
+        {
+            if (semaphore)
+                vkDestroySemaphore(mDevice, semaphore,
+                                   mHostAllocator.Callbacks());
+        }
+        mRenderFinishedSemaphores.clear();
+    }
+
+    if (!mFrames.empty())
+    {
+        // Command buffers are freed along with the command pool below
+        for (FrameContext &frame : mFrames)
+        {
+            if (frame.imageAvailableSemaphore)
+                vkDestroySemaphore(mDevice, frame.imageAvailableSemaphore,
+                                   mHostAllocator.Callbacks());
+            if (frame.inFlightFence)
+                vkDestroyFence(mDevice, frame.inFlightFence,
+                               mHostAllocator.Callbacks());
+            DestroyBuffer(mAllocator, frame.instanceBuffer);
+            DestroyBuffer(mAllocator, frame.visibleInstanceBuffer);
+            DestroyBuffer(mAllocator, frame.drawBuffer);
+            if (frame.cullFinishedSemaphore)
+                vkDestroySemaphore(mDevice, frame.cullFinishedSemaphore,
+                                   mHostAllocator.Callbacks());
+        }
+        mFrames.clear();
+        mCurrentFrame = 0;
+    }
+
+    DestroyBuffer(mAllocator, mVertexBuffer);
+    DestroyBuffer(mAllocator, mIndexBuffer);
+    mIndexCount = 0;
+    mUploader.Finalize();
+    mGpuProfiler.Finalize();
+
+    if (mCommandPool)
+    {
+        vkDestroyCommandPool(mDevice, mCommandPool, mHostAllocator.Callbacks());
+        mCommandPool = nullptr;
+    }
+
+    if (mComputeCommandPool)
+    {
+        vkDestroyCommandPool(mDevice, mComputeCommandPool,
+                             mHostAllocator.Callbacks());
+        mComputeCommandPool = nullptr;
+    }
+
+    if (!mFramebuffers.empty())
+    {
+        for (VkFramebuffer framebuffer : mFramebuffers)
+        {
+            vkDestroyFramebuffer(mDevice, framebuffer,
+                                 mHostAllocator.Callbacks());
+        }
+        mFramebuffers.clear();
+    }
+
+    if (mRenderPass)
+    {
+        vkDestroyRenderPass(mDevice, mRenderPass, mHostAllocator.Callbacks());
+        mRenderPass = nullptr;
     }
 
     if (mPipelineLayout)
     {
-        vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mPipelineLayout,
+                                mHostAllocator.Callbacks());
         mPipelineLayout = nullptr;
     }
 
+    // Frees the per-frame culling descriptor sets along with it
+    if (mCullDescriptorPool)
+    {
+        vkDestroyDescriptorPool(mDevice, mCullDescriptorPool,
+                                mHostAllocator.Callbacks());
+        mCullDescriptorPool = nullptr;
+    }
+
+    if (mCullPipelineLayout)
+    {
+        vkDestroyPipelineLayout(mDevice, mCullPipelineLayout,
+                                mHostAllocator.Callbacks());
+        mCullPipelineLayout = nullptr;
+    }
+
+    if (mCullDescriptorSetLayout)
+    {
+        vkDestroyDescriptorSetLayout(mDevice, mCullDescriptorSetLayout,
+                                     mHostAllocator.Callbacks());
+        mCullDescriptorSetLayout = nullptr;
+    }
+
     if (!mSwapChainImageViews.empty())
     {
         for (const VkImageView &imageView : mSwapChainImageViews)
         {
-            vkDestroyImageView(mDevice, imageView, nullptr);
+            vkDestroyImageView(mDevice, imageView, mHostAllocator.Callbacks());
         }
         mSwapChainImageViews.clear();
     }
 
     if (mSwapChain)
     {
-        vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+        vkDestroySwapchainKHR(mDevice, mSwapChain, mHostAllocator.Callbacks());
         mSwapChain = nullptr;
     }
 
+    if (!mOffscreenImageAllocations.empty())
+    {
+        // Offscreen targets are owned by us rather than by a swap chain
+        for (VkImage image : mSwapChainImages)
+        {
+            if (image)
+                vkDestroyImage(mDevice, image, mHostAllocator.Callbacks());
+        }
+        for (TriAllocation &allocation : mOffscreenImageAllocations)
+        {
+            mAllocator.Free(allocation);
+        }
+        mOffscreenImageAllocations.clear();
+    }
+    mSwapChainImages.clear();
+
     if (mGraphicsQueue)
         mGraphicsQueue = nullptr;
 
     if (mPresentQueue)
         mPresentQueue = nullptr;
 
+    mTransferQueue = nullptr;
+    mComputeQueue = nullptr;
+
     if (mSurface)
     {
-        vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+        vkDestroySurfaceKHR(mInstance, mSurface, mHostAllocator.Callbacks());
         mSurface = nullptr;
     }
 
     if (mDevice)
     {
-        vkDestroyDevice(mDevice, nullptr);
+        mAllocator.LogStats();
+        mAllocator.Finalize();
+
+        vkDestroyDevice(mDevice, mHostAllocator.Callbacks());
         mDevice = nullptr;
+
+        mUseDynamicRendering = false;
     }
 
     if (mPhysicalDevice)
@@ -911,8 +2050,11 @@ void TriApp::Finalize()
 #if TRI_WITH_VULKAN_VALIDATION
     if (mDebugUtilsMessenger)
     {
-        mLibrary.DestroyDebugUtilsMessengerEXT(mInstance, mDebugUtilsMessenger,
-                                               nullptr);
+        if (mLibrary.DestroyDebugUtilsMessengerEXT)
+        {
+            mLibrary.DestroyDebugUtilsMessengerEXT(
+                mInstance, mDebugUtilsMessenger, mHostAllocator.Callbacks());
+        }
         mDebugUtilsMessenger = nullptr;
     }
 #endif
@@ -922,10 +2064,13 @@ void TriApp::Finalize()
     if (mInstance)
     {
         TriLogInfo() << "Finalizing VkInstance: " << mInstance;
-        vkDestroyInstance(mInstance, nullptr);
+        vkDestroyInstance(mInstance, mHostAllocator.Callbacks());
         mInstance = nullptr;
     }
 
+    mHostAllocator.LogStats();
+    mHostAllocator.Finalize();
+
     if (mpWindow)
     {
         glfwDestroyWindow(mpWindow);
@@ -933,7 +2078,8 @@ void TriApp::Finalize()
         mpWindow = nullptr;
     }
 
-    mDeviceExtensions.clear();
+    mDeviceSelector.Finalize();
+    mDeviceProfile = TriDeviceProfile();
 
     mInstanceExtensions.clear();
     mInstanceLayers.clear();
@@ -995,87 +2141,38 @@ void TriApp::PopulateDebugUtilsMessengerCreateInfoEXT(
     createInfo.pUserData = this;
 }
 
-int TriApp::RateDeviceSuitability(
-    VkPhysicalDevice device, const std::vector<const char *> &reqExtensions)
+bool TriApp::IsDeviceSuitable(const TriDeviceProfile &profile,
+                              const std::vector<const char *> &reqExtensions)
 {
-    VkPhysicalDeviceProperties props;
-    VkPhysicalDeviceFeatures feats;
-    vkGetPhysicalDeviceProperties(device, &props);
-    vkGetPhysicalDeviceFeatures(device, &feats);
-
-    uint32_t numDeviceExtensions = 0;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &numDeviceExtensions,
-                                         nullptr);
-    mDeviceExtensions.resize(numDeviceExtensions);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &numDeviceExtensions,
-                                         mDeviceExtensions.data());
-
-    // TODO(42): Manually add swap chain support check here (even if it is
-    // missing)
-
     for (const char *extension : reqExtensions)
     {
-        auto position = std::find_if(
-            mDeviceExtensions.begin(), mDeviceExtensions.end(),
-            [&](const VkExtensionProperties &props)
-            { return std::string(extension) == props.extensionName; });
-
-        if (position == mDeviceExtensions.end())
+        if (!profile.HasExtension(extension))
         {
-            TriLogError() << "Device '" << props.deviceName
-                          << "' is missing required device extension: "
-                          << extension;
-            return 0;
+            TriLogWarning() << "Device '" << profile.props.deviceName
+                            << "' is missing required device extension: "
+                            << extension;
+            return false;
         }
     }
 
     TriLogVerbose() << "All required device extensions found for device '"
-                    << props.deviceName << "'";
+                    << profile.props.deviceName << "'";
 
-    SwapChainSupportDetails details = QuerySwapChainSupport(device);
-
-    if (details.formats.empty() || details.presentModes.empty())
+    if (!mSettings.headless)
     {
-        // The swap chain cannot be presented
-        TriLogWarning() << "Device does not support swap chain with any "
-                           "formats/present modes";
-        return 0;
-    }
+        SwapChainSupportDetails details = QuerySwapChainSupport(profile.device);
 
-    int score = 0;
-
-    switch (props.deviceType)
-    {
-    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-        score = 1;
-        break;
-
-    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-        score = 2;
-        break;
-
-    default:
-        score = 0;
-        break;
-    }
-
-    if (feats.geometryShader)
-        score *= 2;
-
-    if (feats.tessellationShader)
-        score *= 2;
-
-    if (score == 0)
-    {
-        TriLogWarning() << "Device '" << props.deviceName << "' unsuitable";
-    }
-    else
-    {
-        TriLogVerbose() << "Device '" << props.deviceName << "' has a score of "
-                        << score;
+        if (details.formats.empty() || details.presentModes.empty())
+        {
+            // The swap chain cannot be presented
+            TriLogWarning() << "Device '" << profile.props.deviceName
+                            << "' does not support swap chain with any "
+                               "formats/present modes";
+            return false;
+        }
     }
 
-    return score;
+    return true;
 }
 
 QueueFamilyIndices TriApp::FindQueueFamilies()
@@ -1099,33 +2196,65 @@ QueueFamilyIndices TriApp::FindQueueFamilies()
         TriLogVerbose() << "Queue family #" << i << " flags: 0x" << std::hex
                         << prop.queueFlags << std::dec;
 
-        if (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        bool graphics = prop.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = prop.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        bool transfer = prop.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+        if (graphics && !indices.graphicsFamily.has_value())
         {
             indices.graphicsFamily = i;
         }
 
-        VkBool32 presentSupport = false;
-        VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(
-            mPhysicalDevice, i, mSurface, &presentSupport);
-        if (result == VK_SUCCESS)
+        // Transfer-only families are the DMA engines, which copy without
+        // taking any time away from graphics or compute
+        if (transfer && !graphics && !compute &&
+            !indices.transferFamily.has_value())
         {
-            indices.presentFamily = i;
+            indices.transferFamily = i;
         }
-        else
+
+        if (compute && !graphics && !indices.computeFamily.has_value())
         {
-            TriLogWarning() << "Failed to get physical device surface support "
-                               "info for queue family index "
-                            << i;
+            indices.computeFamily = i;
         }
 
-        i++;
-
-        if (indices.IsComplete())
+        // There is no surface to present to in headless mode
+        if (!mSettings.headless)
         {
-            break;
+            VkBool32 presentSupport = false;
+            VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(
+                mPhysicalDevice, i, mSurface, &presentSupport);
+            if (result != VK_SUCCESS)
+            {
+                TriLogWarning()
+                    << "Failed to get physical device surface support "
+                       "info for queue family index "
+                    << i;
+            }
+            else if (presentSupport &&
+                     (!indices.presentFamily.has_value() ||
+                      indices.graphicsFamily == i))
+            {
+                // Presenting from the graphics family keeps the swap chain
+                // images exclusive to one family
+                indices.presentFamily = i;
+            }
         }
+
+        i++;
     }
 
+    // Without a transfer-only family, an async compute family still copies
+    // off the graphics queue; otherwise everything shares the graphics queue
+    if (!indices.transferFamily.has_value())
+        indices.transferFamily = indices.computeFamily;
+
+    if (!indices.transferFamily.has_value() || !mSettings.asyncQueues)
+        indices.transferFamily = indices.graphicsFamily;
+
+    if (!indices.computeFamily.has_value() || !mSettings.asyncQueues)
+        indices.computeFamily = indices.graphicsFamily;
+
     return indices;
 }
 
@@ -1179,8 +2308,44 @@ VkSurfaceFormatKHR TriApp::ChooseSwapSurfaceFormat(
 VkPresentModeKHR
 TriApp::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> &presentModes)
 {
-    // VK_PRESENT_MODE_FIFO_KHR is guaranteed to be available
-    return VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+
+    switch (mSettings.presentMode)
+    {
+    case TriPresentFifo:
+        requested = VK_PRESENT_MODE_FIFO_KHR;
+        break;
+
+    case TriPresentFifoRelaxed:
+        requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        break;
+
+    case TriPresentMailbox:
+        requested = VK_PRESENT_MODE_MAILBOX_KHR;
+        break;
+
+    case TriPresentImmediate:
+        requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        break;
+    }
+
+    auto position =
+        std::find(presentModes.begin(), presentModes.end(), requested);
+
+    if (position == presentModes.end())
+    {
+        TriLogWarning() << "Present mode '"
+                        << TriPresentModeName(mSettings.presentMode)
+                        << "' unavailable, falling back to fifo";
+
+        // VK_PRESENT_MODE_FIFO_KHR is guaranteed to be available
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    TriLogInfo() << "Present mode: "
+                 << TriPresentModeName(mSettings.presentMode);
+
+    return requested;
 }
 
 VkExtent2D
@@ -1206,7 +2371,7 @@ TriApp::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities)
     VkExtent2D ret{};
     ret.width = glm::clamp(static_cast<uint32_t>(fbWidth), minExtent.width,
                            maxExtent.width);
-    ret.height = glm::clamp(static_cast<uint32_t>(fbHeight), minExtent.width,
+    ret.height = glm::clamp(static_cast<uint32_t>(fbHeight), minExtent.height,
                             maxExtent.height);
 
     TriLogVerbose() << "Retrieved clamped GLFW frame buffer size: " << ret.width
@@ -1215,37 +2380,18 @@ TriApp::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities)
     return ret;
 }
 
-VkShaderModule TriApp::CreateShaderModule(const std::vector<char> &svcBuffer)
-{
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-    createInfo.codeSize = svcBuffer.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(svcBuffer.data());
-
-    VkShaderModule shaderModule = nullptr;
-    VkResult result =
-        vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderModule);
-
-    if (result != VK_SUCCESS)
-    {
-        TriLogError() << "Failed during Vulkan shader module creation";
-        return nullptr;
-    }
-
-    return shaderModule;
-}
-
 bool TriApp::RecordCommandBuffer(VkCommandBuffer commandBuffer,
                                  uint32_t imageIndex)
 {
+    TRI_CPU_SCOPE("RecordCommandBuffer");
+
     VkCommandBufferBeginInfo commandBufferBeginInfo{};
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     commandBufferBeginInfo.pNext = nullptr;
     commandBufferBeginInfo.pInheritanceInfo = nullptr;
 
     VkResult result =
-        vkBeginCommandBuffer(mCommandBuffer, &commandBufferBeginInfo);
+        mLibrary.BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 
     if (result != VK_SUCCESS)
     {
@@ -1253,22 +2399,46 @@ bool TriApp::RecordCommandBuffer(VkCommandBuffer commandBuffer,
         return false;
     }
 
-    VkRenderPassBeginInfo renderPassBeginInfo{};
-    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassBeginInfo.pNext = nullptr;
-    renderPassBeginInfo.renderPass = mRenderPass;
-    renderPassBeginInfo.framebuffer = mFramebuffers[imageIndex];
-    renderPassBeginInfo.renderArea.offset = {0, 0};
-    renderPassBeginInfo.renderArea.extent = mSwapExtent;
+    const FrameContext &frame = mFrames[mCurrentFrame];
+    uint32_t graphicsFamily = *mQueueFamilyIndices.graphicsFamily;
+
+    uint32_t frameScope = mGpuProfiler.BeginScope(
+        commandBuffer, graphicsFamily, kGpuFrameScope, false);
+
+    if (mCullPipeline && mQueueFamilyIndices.HasAsyncCompute())
+        RecordCullAcquire(commandBuffer, frame);
+    else if (mCullPipeline)
+        RecordCullPass(commandBuffer, frame);
+
+    // Statistics queries may not begin inside the render pass
+    uint32_t drawScope = mGpuProfiler.BeginScope(commandBuffer, graphicsFamily,
+                                                 kGpuDrawScope, true);
+
     VkClearValue clearColor{};
     clearColor.color = {{1.0f, 0.0f, 1.0f, 1.0f}};
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = &clearColor;
 
-    vkCmdBeginRenderPass(mCommandBuffer, &renderPassBeginInfo,
-                         VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      mGraphicsPipeline);
+    if (mUseDynamicRendering)
+    {
+        BeginDynamicRendering(commandBuffer, imageIndex, clearColor);
+    }
+    else
+    {
+        VkRenderPassBeginInfo renderPassBeginInfo{};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.pNext = nullptr;
+        renderPassBeginInfo.renderPass = mRenderPass;
+        renderPassBeginInfo.framebuffer = mFramebuffers[imageIndex];
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = mSwapExtent;
+        renderPassBeginInfo.clearValueCount = 1;
+        renderPassBeginInfo.pClearValues = &clearColor;
+
+        mLibrary.CmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    mLibrary.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             mGraphicsPipeline);
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -1282,14 +2452,44 @@ bool TriApp::RecordCommandBuffer(VkCommandBuffer commandBuffer,
     scissor.offset = {0, 0};
     scissor.extent = mSwapExtent;
 
-    vkCmdSetViewport(mCommandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(mCommandBuffer, 0, 1, &scissor);
+    mLibrary.CmdSetViewport(commandBuffer, 0, 1, &viewport);
+    mLibrary.CmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // Recorded into the current slot, so bind that slot's instance buffer;
+    // with GPU culling only the instances that survived are drawn
+    VkBuffer vertexBuffers[] = {mVertexBuffer.buffer,
+                                mCullPipeline
+                                    ? frame.visibleInstanceBuffer.buffer
+                                    : frame.instanceBuffer.buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    mLibrary.CmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    mLibrary.CmdBindIndexBuffer(commandBuffer, mIndexBuffer.buffer, 0,
+                                VK_INDEX_TYPE_UINT32);
+
+    // A single draw regardless of the instance count
+    if (mCullPipeline)
+    {
+        mLibrary.CmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer.buffer,
+                                        0, 1,
+                                        sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+    {
+        uint32_t instanceCount =
+            static_cast<uint32_t>(mStressScene.GetCount());
+        mLibrary.CmdDrawIndexed(commandBuffer, mIndexCount, instanceCount, 0,
+                                0, 0);
+    }
 
-    vkCmdDraw(mCommandBuffer, 3, 1, 0, 0);
+    if (mUseDynamicRendering)
+        EndDynamicRendering(commandBuffer, imageIndex);
+    else
+        mLibrary.CmdEndRenderPass(commandBuffer);
 
-    vkCmdEndRenderPass(mCommandBuffer);
+    mGpuProfiler.EndScope(commandBuffer, drawScope);
+    mGpuProfiler.EndScope(commandBuffer, frameScope);
 
-    result = vkEndCommandBuffer(mCommandBuffer);
+    result = mLibrary.EndCommandBuffer(commandBuffer);
 
     if (result != VK_SUCCESS)
     {
@@ -1300,49 +2500,491 @@ bool TriApp::RecordCommandBuffer(VkCommandBuffer commandBuffer,
     return true;
 }
 
+static void TransitionImageLayout(const VkExtLibary &library,
+                                  VkCommandBuffer commandBuffer, VkImage image,
+                                  VkImageLayout oldLayout,
+                                  VkImageLayout newLayout,
+                                  VkPipelineStageFlags srcStage,
+                                  VkAccessFlags srcAccess,
+                                  VkPipelineStageFlags dstStage,
+                                  VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    library.CmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0,
+                               nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TriApp::BeginDynamicRendering(VkCommandBuffer commandBuffer,
+                                   uint32_t imageIndex,
+                                   const VkClearValue &clearColor)
+{
+    /* What the render pass did implicitly: the previous contents are
+       discarded, and the transition waits for the same stage that the
+       image available semaphore is waited on (as the subpass dependency
+       did)
+    */
+    TransitionImageLayout(mLibrary, commandBuffer, mSwapChainImages[imageIndex],
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.pNext = nullptr;
+    colorAttachment.imageView = mSwapChainImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearColor;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.pNext = nullptr;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = mSwapExtent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.viewMask = 0;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = nullptr;
+    renderingInfo.pStencilAttachment = nullptr;
+
+    mLibrary.CmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void TriApp::EndDynamicRendering(VkCommandBuffer commandBuffer,
+                                 uint32_t imageIndex)
+{
+    mLibrary.CmdEndRendering(commandBuffer);
+
+    // Same final layouts as the render pass path
+    VkImageLayout finalLayout = mSettings.headless
+                                    ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    TransitionImageLayout(mLibrary, commandBuffer, mSwapChainImages[imageIndex],
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                          finalLayout,
+                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+}
+
+bool TriApp::QueryDynamicRendering(const TriDeviceProfile &profile,
+                                   bool &needsExtension)
+{
+    // vkGetPhysicalDeviceFeatures2 is core since 1.1; the extension needs
+    // its 1.2 dependencies (create_renderpass2, depth_stencil_resolve)
+    uint32_t apiVersion =
+        std::min(profile.props.apiVersion, mInstanceApiVersion);
+    if (apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    needsExtension = apiVersion < VK_API_VERSION_1_3;
+
+    if (needsExtension &&
+        !profile.HasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+        return false;
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeats{};
+    dynamicRenderingFeats.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    dynamicRenderingFeats.pNext = nullptr;
+
+    VkPhysicalDeviceFeatures2 feats{};
+    feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    feats.pNext = &dynamicRenderingFeats;
+
+    vkGetPhysicalDeviceFeatures2(profile.device, &feats);
+
+    return dynamicRenderingFeats.dynamicRendering == VK_TRUE;
+}
+
+void TriApp::RecordCullPass(VkCommandBuffer commandBuffer,
+                            const FrameContext &frame)
+{
+    /* On an async compute queue this times the compute submission, which
+       overlaps the graphics one; otherwise it nests in the frame scope
+    */
+    bool release = mQueueFamilyIndices.HasAsyncCompute();
+    uint32_t family = release ? *mQueueFamilyIndices.computeFamily
+                              : *mQueueFamilyIndices.graphicsFamily;
+    uint32_t cullScope =
+        mGpuProfiler.BeginScope(commandBuffer, family, kGpuCullScope, false);
+
+    // Start from zero instances; the shader appends the visible ones
+    VkDrawIndexedIndirectCommand draw{};
+    draw.indexCount = mIndexCount;
+    draw.instanceCount = 0;
+    draw.firstIndex = 0;
+    draw.vertexOffset = 0;
+    draw.firstInstance = 0;
+
+    mLibrary.CmdUpdateBuffer(commandBuffer, frame.drawBuffer.buffer, 0,
+                             sizeof(draw), &draw);
+
+    VkBufferMemoryBarrier resetBarrier{};
+    resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    resetBarrier.pNext = nullptr;
+    resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.buffer = frame.drawBuffer.buffer;
+    resetBarrier.offset = 0;
+    resetBarrier.size = VK_WHOLE_SIZE;
+
+    mLibrary.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                                nullptr, 1, &resetBarrier, 0, nullptr);
+
+    struct
+    {
+        uint32_t instanceCount;
+        float meshRadius;
+    } cull = {static_cast<uint32_t>(mStressScene.GetCount()), mMeshRadius};
+
+    mLibrary.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                             mCullPipeline);
+    mLibrary.CmdBindDescriptorSets(commandBuffer,
+                                   VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   mCullPipelineLayout, 0, 1,
+                                   &frame.cullDescriptorSet, 0, nullptr);
+    mLibrary.CmdPushConstants(commandBuffer, mCullPipelineLayout,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(cull),
+                              &cull);
+
+    /* 64 invocations per group, see Shaders/cull.comp. The spec only
+       guarantees 65535 groups per dimension, far fewer than TRI_MAX_INSTANCES
+       needs, so the groups are laid out in rows of at most that many.
+    */
+    const uint32_t *maxGroups =
+        mDeviceProfile.props.limits.maxComputeWorkGroupCount;
+    uint32_t groups = (cull.instanceCount + 63) / 64;
+    uint32_t groupsX = std::min(groups, maxGroups[0]);
+    uint32_t groupsY = groupsX == 0 ? 0 : (groups + groupsX - 1) / groupsX;
+
+    mLibrary.CmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+    /* The draw consumes both the arguments & the compacted instances. On an
+       async compute queue this is the release half of the ownership
+       transfer to the graphics family (see RecordCullAcquire()).
+    */
+    VkBufferMemoryBarrier cullBarriers[2]{};
+    for (VkBufferMemoryBarrier &barrier : cullBarriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex =
+            release ? *mQueueFamilyIndices.computeFamily
+                    : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex =
+            release ? *mQueueFamilyIndices.graphicsFamily
+                    : VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    }
+
+    cullBarriers[0].buffer = frame.drawBuffer.buffer;
+    cullBarriers[1].buffer = frame.visibleInstanceBuffer.buffer;
+
+    if (release)
+    {
+        mLibrary.CmdPipelineBarrier(commandBuffer,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                    nullptr, 2, cullBarriers, 0, nullptr);
+        mGpuProfiler.EndScope(commandBuffer, cullScope);
+        return;
+    }
+
+    cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    cullBarriers[1].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+    mLibrary.CmdPipelineBarrier(commandBuffer,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                0, 0, nullptr, 2, cullBarriers, 0, nullptr);
+
+    mGpuProfiler.EndScope(commandBuffer, cullScope);
+}
+
+bool TriApp::SubmitCullPass(const FrameContext &frame)
+{
+    TRI_CPU_SCOPE("SubmitCullPass");
+
+    mLibrary.ResetCommandBuffer(frame.computeCommandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (mLibrary.BeginCommandBuffer(frame.computeCommandBuffer, &beginInfo) !=
+        VK_SUCCESS)
+    {
+        TriLogError() << "Failed to begin compute command buffer";
+        return false;
+    }
+
+    RecordCullPass(frame.computeCommandBuffer, frame);
+
+    if (mLibrary.EndCommandBuffer(frame.computeCommandBuffer) != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to end compute command buffer";
+        return false;
+    }
+
+    /* No fence: the graphics submission waits on the semaphore, so the
+       frame's in-flight fence also covers this command buffer
+    */
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.computeCommandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &frame.cullFinishedSemaphore;
+
+    VkResult result =
+        mLibrary.QueueSubmit(mComputeQueue, 1, &submitInfo, nullptr);
+    if (result != VK_SUCCESS)
+    {
+        OnFrameError(result, "submit the cull pass");
+        return false;
+    }
+
+    return true;
+}
+
+void TriApp::RecordCullAcquire(VkCommandBuffer commandBuffer,
+                               const FrameContext &frame)
+{
+    VkBufferMemoryBarrier acquires[2]{};
+    for (VkBufferMemoryBarrier &acquire : acquires)
+    {
+        acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        acquire.pNext = nullptr;
+        acquire.srcAccessMask = 0;
+        acquire.srcQueueFamilyIndex = *mQueueFamilyIndices.computeFamily;
+        acquire.dstQueueFamilyIndex = *mQueueFamilyIndices.graphicsFamily;
+        acquire.offset = 0;
+        acquire.size = VK_WHOLE_SIZE;
+    }
+
+    acquires[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    acquires[0].buffer = frame.drawBuffer.buffer;
+    acquires[1].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    acquires[1].buffer = frame.visibleInstanceBuffer.buffer;
+
+    // Same stages as the semaphore wait, which chains the two
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+    mLibrary.CmdPipelineBarrier(commandBuffer, stages, stages, 0, 0, nullptr, 2,
+                                acquires, 0, nullptr);
+}
+
 void TriApp::RenderFrame()
 {
+    UpdateCpuTrace();
+
+    TRI_CPU_SCOPE("RenderFrame");
+    TriClock::time_point frameStart = TriClock::now();
+    mLastFrameTimings = TriFrameTimings();
+
+    // Blocks only if the pipeline is still compiling on the builder
+    if (!WaitForGraphicsPipeline())
+        return;
+
+    PollShaderReload();
+
+    // Reclaim staging memory of uploads that have landed
+    {
+        TRI_CPU_SCOPE("CollectUploads");
+        mUploader.Collect(false);
+    }
+
+    if (mSettings.headless)
+        RenderOffscreenFrame();
+    else
+        RenderSwapChainFrame();
+
+    mLastFrameTimings.cpuFrameMs = TriElapsedMs(frameStart);
+
+    if (mLastFrameTimings.rendered)
+    {
+        mCpuBusyStat.Add(mLastFrameTimings.cpuFrameMs -
+                         mLastFrameTimings.fenceWaitMs -
+                         mLastFrameTimings.acquireMs -
+                         mLastFrameTimings.presentMs);
+    }
+
+    if (mLastFrameTimings.gpuTimed)
+        mGpuFrameStat.Add(mLastFrameTimings.gpuFrameMs);
+
+    if (mLastFrameTimings.rendered && !mFirstFrameReported)
+    {
+        TriLogInfo() << "Time to first frame: " << TriElapsedMs(mInitStartTime)
+                     << " ms (waited " << mPipelineWaitMs
+                     << " ms for pipelines, pipeline cache "
+                     << (mPipelineCache.IsWarm() ? "warm" : "cold") << ")";
+        mFirstFrameReported = true;
+    }
+}
+
+void TriApp::RenderSwapChainFrame()
+{
+    if (mSwapChainDirty && !RecreateSwapChain())
+    {
+        // Skip the frame until there is something to present to again
+        return;
+    }
+
+    FrameContext &frame = mFrames[mCurrentFrame];
+
+    /* Only wait for the frame that last used this slot of the ring; the other
+       frames in flight keep the GPU busy while we record this one
+    */
     uint64_t infinite = std::numeric_limits<uint64_t>::max();
-    vkWaitForFences(mDevice, 1, &mInFlightFence, true,
-                    infinite);
-    vkResetFences(mDevice, 1, &mInFlightFence);
-    
+    TriClock::time_point waitStart = TriClock::now();
+    VkResult result = VK_SUCCESS;
+    {
+        TRI_CPU_SCOPE("vkWaitForFences");
+        result = mLibrary.WaitForFences(mDevice, 1, &frame.inFlightFence, true,
+                                        infinite);
+    }
+    mLastFrameTimings.fenceWaitMs = TriElapsedMs(waitStart);
+
+    if (result != VK_SUCCESS)
+    {
+        OnFrameError(result, "wait for the frame's fence");
+        return;
+    }
+
+    ReadGpuTimings(mCurrentFrame);
+
+    ReleaseRetiredSwapChains(false);
+    ReleaseRetiredPipelines(false);
+
+    TriClock::time_point acquireStart = TriClock::now();
+
     uint32_t imageIndex = 0;
-    vkAcquireNextImageKHR(mDevice, mSwapChain, infinite,
-                          mImageAvailableSemaphore, nullptr, &imageIndex);
+    {
+        TRI_CPU_SCOPE("vkAcquireNextImageKHR");
+        result = mLibrary.AcquireNextImageKHR(mDevice, mSwapChain, infinite,
+                                              frame.imageAvailableSemaphore,
+                                              nullptr, &imageIndex);
+    }
+    mLastFrameTimings.acquireMs = TriElapsedMs(acquireStart);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // Nothing was acquired, so the fence stays signaled for the retry
+        mSwapChainDirty = true;
+        return;
+    }
+    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    {
+        OnFrameError(result, "acquire a swap chain image");
+        return;
+    }
+
+    // Only reset once we know work will be submitted for this frame
+    mLibrary.ResetFences(mDevice, 1, &frame.inFlightFence);
+
+    TriLogVerbose() << "Draw frame #" << mCurrentFrame
+                    << " on swap chain image: #" << imageIndex;
 
-    TriLogVerbose() << "Draw one frame on swap chain image: #" << imageIndex;
+    mLastFrameTimings.instanceUpdateMs = UpdateInstances(frame);
+
+    // Culls on the compute queue while the graphics queue is still busy
+    bool asyncCull = mCullPipeline && mQueueFamilyIndices.HasAsyncCompute();
+    if (asyncCull && !SubmitCullPass(frame))
+    {
+        // The image goes back along with the swap chain
+        AbandonFrame(frame, true, false);
+        mSwapChainDirty = true;
+        return;
+    }
 
     // Though this may be unnecessary, it's better that we reset it
-    vkResetCommandBuffer(mCommandBuffer, 0);
-    RecordCommandBuffer(mCommandBuffer, imageIndex);
+    TriClock::time_point recordStart = TriClock::now();
+    mLibrary.ResetCommandBuffer(frame.commandBuffer, 0);
+    bool recorded = RecordCommandBuffer(frame.commandBuffer, imageIndex);
+    mLastFrameTimings.recordMs = TriElapsedMs(recordStart);
+
+    if (!recorded)
+    {
+        AbandonFrame(frame, true, asyncCull);
+        mSwapChainDirty = true;
+        return;
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pNext = nullptr;
 
     // Wait until swap chain image is available (signaled after
-    // vkAcquireNextImageKHR)
-    VkSemaphore waitSemaphores[] = {mImageAvailableSemaphore};
+    // vkAcquireNextImageKHR), and for the cull pass before the draw
+    VkSemaphore waitSemaphores[] = {frame.imageAvailableSemaphore,
+                                    frame.cullFinishedSemaphore};
     VkPipelineStageFlags waitStages[] = {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
 
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = asyncCull ? 2 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &mCommandBuffer;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
 
-    VkSemaphore signalSemaphore[] = {mRenderFinishedSemaphore};
+    VkSemaphore signalSemaphore[] = {mRenderFinishedSemaphores[imageIndex]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphore;
 
-    VkResult result =
-        vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mInFlightFence);
+    // Advance the ring even if anything below fails
+    mCurrentFrame = (mCurrentFrame + 1) % mFrames.size();
+    mFrameNumber++;
+
+    mGpuProfiler.EndFrame();
+
+    TriClock::time_point submitStart = TriClock::now();
+    {
+        TRI_CPU_SCOPE("vkQueueSubmit");
+        result = mLibrary.QueueSubmit(mGraphicsQueue, 1, &submitInfo,
+                                      frame.inFlightFence);
+    }
+    mLastFrameTimings.submitMs = TriElapsedMs(submitStart);
 
     if (result != VK_SUCCESS)
     {
-        TriLogError() << "Failed to submit command buffer to queue";
+        OnFrameError(result, "submit command buffer to queue");
+        AbandonFrame(frame, true, asyncCull);
+        mSwapChainDirty = true;
         return;
     }
 
@@ -1350,7 +2992,7 @@ void TriApp::RenderFrame()
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.pNext = nullptr;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &mRenderFinishedSemaphore;
+    presentInfo.pWaitSemaphores = signalSemaphore;
 
     VkSwapchainKHR swapChains[] = {mSwapChain};
     presentInfo.swapchainCount = 1;
@@ -1358,11 +3000,167 @@ void TriApp::RenderFrame()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
-    result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+    TriClock::time_point presentStart = TriClock::now();
+    {
+        TRI_CPU_SCOPE("vkQueuePresentKHR");
+        result = mLibrary.QueuePresentKHR(mPresentQueue, &presentInfo);
+    }
+
+    TriClock::time_point presentEnd = TriClock::now();
+    mLastFrameTimings.presentMs = TriElapsedMs(presentStart, presentEnd);
+    mLastFrameTimings.rendered = true;
+
+    mAcquireToPresentStat.Add(TriElapsedMs(acquireStart, presentEnd));
+    mRenderedFrames++;
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    {
+        mSwapChainDirty = true;
+    }
+    else if (result != VK_SUCCESS)
+    {
+        OnFrameError(result, "present queue");
+        return;
+    }
+}
+
+void TriApp::RenderOffscreenFrame()
+{
+    FrameContext &frame = mFrames[mCurrentFrame];
+
+    uint64_t infinite = std::numeric_limits<uint64_t>::max();
+    TriClock::time_point waitStart = TriClock::now();
+    VkResult result = VK_SUCCESS;
+    {
+        TRI_CPU_SCOPE("vkWaitForFences");
+        result = mLibrary.WaitForFences(mDevice, 1, &frame.inFlightFence, true,
+                                        infinite);
+    }
+    mLastFrameTimings.fenceWaitMs = TriElapsedMs(waitStart);
+
+    if (result != VK_SUCCESS)
+    {
+        OnFrameError(result, "wait for the frame's fence");
+        return;
+    }
+
+    mLibrary.ResetFences(mDevice, 1, &frame.inFlightFence);
+
+    ReadGpuTimings(mCurrentFrame);
+
+    ReleaseRetiredPipelines(false);
+
+    // There is one offscreen target per frame in flight, so the fence above
+    // also guarantees that the target is no longer in use
+    uint32_t imageIndex = mCurrentFrame;
+
+    TriLogVerbose() << "Draw frame #" << mCurrentFrame
+                    << " on offscreen target: #" << imageIndex;
+
+    mLastFrameTimings.instanceUpdateMs = UpdateInstances(frame);
+
+    bool asyncCull = mCullPipeline && mQueueFamilyIndices.HasAsyncCompute();
+    if (asyncCull && !SubmitCullPass(frame))
+    {
+        AbandonFrame(frame, false, false);
+        return;
+    }
+
+    TriClock::time_point recordStart = TriClock::now();
+    mLibrary.ResetCommandBuffer(frame.commandBuffer, 0);
+    bool recorded = RecordCommandBuffer(frame.commandBuffer, imageIndex);
+    mLastFrameTimings.recordMs = TriElapsedMs(recordStart);
+
+    if (!recorded)
+    {
+        AbandonFrame(frame, false, asyncCull);
+        return;
+    }
+
+    VkPipelineStageFlags cullWaitStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = asyncCull ? 1 : 0;
+    submitInfo.pWaitSemaphores = &frame.cullFinishedSemaphore;
+    submitInfo.pWaitDstStageMask = &cullWaitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+
+    mCurrentFrame = (mCurrentFrame + 1) % mFrames.size();
+    mFrameNumber++;
+
+    mGpuProfiler.EndFrame();
+
+    TriClock::time_point submitStart = TriClock::now();
+    {
+        TRI_CPU_SCOPE("vkQueueSubmit");
+        result = mLibrary.QueueSubmit(mGraphicsQueue, 1, &submitInfo,
+                                      frame.inFlightFence);
+    }
+    mLastFrameTimings.submitMs = TriElapsedMs(submitStart);
 
     if (result != VK_SUCCESS)
     {
-        TriLogError() << "Failed to present queue";
+        OnFrameError(result, "submit command buffer to queue");
+        AbandonFrame(frame, false, asyncCull);
         return;
     }
+
+    mLastFrameTimings.rendered = true;
+    mRenderedFrames++;
+}
+
+void TriApp::AbandonFrame(const FrameContext &frame, bool imageAcquired,
+                          bool cullSubmitted)
+{
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint32_t waitCount = 0;
+
+    if (imageAcquired)
+    {
+        waitSemaphores[waitCount] = frame.imageAvailableSemaphore;
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+
+    if (cullSubmitted)
+    {
+        waitSemaphores[waitCount] = frame.cullFinishedSemaphore;
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 0;
+    submitInfo.signalSemaphoreCount = 0;
+
+    // Failing here too most likely means a lost device, which stops the app
+    VkResult result = mLibrary.QueueSubmit(mGraphicsQueue, 1, &submitInfo,
+                                           frame.inFlightFence);
+    if (result != VK_SUCCESS)
+        OnFrameError(result, "retire an abandoned frame");
+}
+
+void TriApp::OnFrameError(VkResult result, const char *what)
+{
+    TriLogError() << "Failed to " << what << ": " << result;
+
+    // Our own swap chains are all destroyed before a fresh one is created,
+    // so a window still in use belongs to someone else
+    if ((result == VK_ERROR_DEVICE_LOST ||
+         result == VK_ERROR_SURFACE_LOST_KHR ||
+         result == VK_ERROR_NATIVE_WINDOW_IN_USE_KHR) &&
+        !mFatalError)
+    {
+        TriLogError() << "Unrecoverable, stopping";
+        mFatalError = true;
+    }
 }
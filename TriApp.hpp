@@ -1,7 +1,21 @@
 #pragma once
 
+#include "TriBuffer.hpp"
 #include "TriGraphicsUtils.hpp"
 #include "TriConfig.hpp"
+#include "TriCpuProfiler.hpp"
+#include "TriDeviceSelector.hpp"
+#include "TriFrameStats.hpp"
+#include "TriGpuProfiler.hpp"
+#include "TriHostAllocator.hpp"
+#include "TriMemoryAllocator.hpp"
+#include "TriPipelineBuilder.hpp"
+#include "TriPipelineVariantCache.hpp"
+#include "TriPipelineCache.hpp"
+#include "TriSettings.hpp"
+#include "TriShaderWatcher.hpp"
+#include "TriStressScene.hpp"
+#include "TriUploader.hpp"
 #include "VkExtLibrary.hpp"
 
 #include <vulkan/vk_platform.h>
@@ -9,24 +23,44 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <future>
+#include <optional>
 #include <string>
 #include <vector>
 
 class TriApp
 {
 public:
-    TriApp(const std::string &appName, int width, int height)
+    TriApp(const std::string &appName, int width, int height,
+           const TriSettings &settings = TriSettings())
         : mpWindow(nullptr), mAppName(appName), width(width), height(height),
-          mInstance(nullptr), mInstanceExtensions(), mInstanceLayers(),
-          mLibrary(), mPhysicalDevice(nullptr), mDevice(nullptr),
-          mGraphicsQueue(nullptr), mPresentQueue(nullptr), mSurface(nullptr),
-          mDeviceExtensions(), mSwapChain(nullptr), mSurfaceFormat(),
+          mSettings(settings), mHostAllocator(), mInstance(nullptr),
+          mInstanceApiVersion(VK_API_VERSION_1_0), mInstanceExtensions(),
+          mInstanceLayers(), mLibrary(), mPhysicalDevice(nullptr),
+          mDevice(nullptr), mGraphicsQueue(nullptr), mPresentQueue(nullptr),
+          mTransferQueue(nullptr), mComputeQueue(nullptr), mAllocator(),
+          mSurface(nullptr), mDeviceSelector(), mDeviceProfile(),
+          mSwapChain(nullptr), mSurfaceFormat(),
           mPresentMode(VK_PRESENT_MODE_FIFO_KHR), mSwapExtent(),
-          mSwapChainImages(), mSwapChainImageViews(), mRenderPass(nullptr),
-          mPipelineLayout(nullptr), mGraphicsPipeline(nullptr), mFramebuffers(),
-          mCommandPool(nullptr), mCommandBuffer(nullptr),
-          mImageAvailableSemaphore(nullptr), mRenderFinishedSemaphore(nullptr),
-          mInFlightFence(nullptr)
+          mSwapChainImages(), mOffscreenImageAllocations(),
+          mSwapChainImageViews(), mRenderPass(nullptr),
+          mUseDynamicRendering(false), mPipelineCache(), mPipelineBuilder(),
+          mPipelineVariants(), mPipelineLayout(nullptr),
+          mGraphicsPipeline(nullptr), mGraphicsPipelineFuture(),
+          mGraphicsPipelineDesc(), mShaderWatcher(), mChangedShaders(),
+          mReloadPipelineFuture(), mRetiredPipelines(),
+          mCullDescriptorSetLayout(nullptr), mCullDescriptorPool(nullptr),
+          mCullPipelineLayout(nullptr), mCullPipeline(nullptr),
+          mCullPipelineFuture(), mFramebuffers(), mCommandPool(nullptr),
+          mComputeCommandPool(nullptr), mFrames(), mCurrentFrame(0),
+          mGpuProfiler(), mRenderFinishedSemaphores(), mUploader(),
+          mVertexBuffer(), mIndexBuffer(), mIndexCount(0), mMeshRadius(0.0f),
+          mStressScene(), mFrameNumber(0), mSwapChainDirty(false),
+          mRetiredSwapChains(), mFatalError(false), mAcquireToPresentStat(),
+          mGpuFrameStat(), mCpuBusyStat(), mRenderedFrames(0), mLoopStartTime(),
+          mLastFrameTimings(), mCpuTraceToggled(false), mCpuTraceEndFrame(0),
+          mInitStartTime(), mInitSteps(), mShaderPreload(),
+          mPipelineWaitMs(0.0), mFirstFrameReported(false)
     {
     #if TRI_WITH_VULKAN_VALIDATION
         mDebugUtilsMessenger = nullptr;
@@ -38,24 +72,65 @@ public:
 public:
     /* Initialize Vulkan-related stuffs:
 
-       1. Create Vulkan instance
+       1. Create Vulkan instance (extensions & layers are enumerated while
+          the window is created, shaders are read in on the side)
        2. Setup debug utils messenger
-       3. Setup swap surface
+       3. Setup swap surface (skipped when headless)
        4. Setup (pick) Vulkan physical device
        5. Setup logical Vulkan device
-       6. Setup swap chains
-       7. Setup swap chain image views
-       8. Setup render pass
-       9. Setup graphics pipeline
-       10. Setup framebuffers
-       11. Setup command buffer pool & command buffer
-       12. Setup synchronization primitives
+       6. Setup render pass (skipped with dynamic rendering)
+       7. Setup graphics & culling pipelines (compiled on worker threads
+          while the steps below run)
+       8. Setup swap chains (offscreen targets when headless)
+       9. Setup swap chain image views
+       10. Setup framebuffers (skipped with dynamic rendering)
+       11. Setup command buffer pool & per-frame command buffers
+       12. Setup synchronization primitives (per frame & per swap chain image)
+       13. Upload geometry into device-local vertex & index buffers, and
+           create the per-frame instance (& culling) buffers
     */
     void Init();
+    VkResult InitSwapChain(VkSwapchainKHR oldSwapChain);
+    VkResult InitOffscreenTargets();
+    VkResult InitSwapChainImageViews();
     VkResult InitGraphicsPipeline();
+    VkResult InitCullPipeline();
+    VkResult InitFramebuffers();
+    VkResult InitRenderFinishedSemaphores();
+
+    VkResult InitGeometry();
+    VkResult InitCullResources();
     void Loop();
+    bool IsRunning();
+    void PollEvents();
     void Finalize();
 
+    // One frame of Loop(); exposed so that tri_bench can drive it directly
+    void RenderFrame();
+
+    const TriFrameTimings &GetLastFrameTimings() const
+    {
+        return mLastFrameTimings;
+    }
+
+    // The device or surface was lost; IsRunning() is false from then on
+    bool HasFatalError() const { return mFatalError; }
+
+    const TriSettings &GetSettings() const { return mSettings; }
+
+    const TriGpuProfiler &GetGpuProfiler() const { return mGpuProfiler; }
+
+    // Wall-clock time of each step of the last Init()
+    const TriStepTimer &GetInitSteps() const { return mInitSteps; }
+
+    // Statistics stay readable after Finalize()
+    const TriHostAllocator &GetHostAllocator() const { return mHostAllocator; }
+
+    std::string GetDeviceName();
+
+    // Triangles submitted by each frame (indices / 3 * instances)
+    uint64_t GetPrimitivesPerFrame() const;
+
 public:
     static VKAPI_ATTR VkBool32 VKAPI_CALL
     VKDebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -63,12 +138,19 @@ public:
                     const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
                     void *pUserData);
 
+    static void FramebufferResizeCallback(GLFWwindow *pWindow, int width,
+                                          int height);
+
+    // F12 starts & stops a CPU trace
+    static void KeyCallback(GLFWwindow *pWindow, int key, int scancode,
+                            int action, int mods);
+
 private:
     void PopulateDebugUtilsMessengerCreateInfoEXT(
         VkDebugUtilsMessengerCreateInfoEXT &createInfo);
 
-    int RateDeviceSuitability(VkPhysicalDevice device,
-                              const std::vector<const char *> &reqExtensions);
+    bool IsDeviceSuitable(const TriDeviceProfile &profile,
+                          const std::vector<const char *> &reqExtensions);
 
     QueueFamilyIndices FindQueueFamilies();
 
@@ -82,11 +164,89 @@ private:
 
     VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
-    VkShaderModule CreateShaderModule(const std::vector<char> &svcBuffer);
-
     bool RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
-    void RenderFrame();
+    /* Dynamic rendering counterparts of vkCmdBegin/EndRenderPass, including
+       the layout transitions the render pass would have done
+    */
+    void BeginDynamicRendering(VkCommandBuffer commandBuffer,
+                               uint32_t imageIndex,
+                               const VkClearValue &clearColor);
+    void EndDynamicRendering(VkCommandBuffer commandBuffer,
+                             uint32_t imageIndex);
+
+    /* Whether the device can render without render passes; needsExtension
+       is set if that goes through VK_KHR_dynamic_rendering (pre-1.3)
+    */
+    bool QueryDynamicRendering(const TriDeviceProfile &profile,
+                               bool &needsExtension);
+
+    /* Reset the frame's indirect draw, then cull its instances into the
+       visible instance buffer. Recorded outside of the render pass.
+    */
+    void RecordCullPass(VkCommandBuffer commandBuffer,
+                        const FrameContext &frame);
+
+    /* With an async compute queue: record the cull pass into the frame's
+       compute command buffer & submit it, and (on the graphics side) acquire
+       the buffers it released
+    */
+    bool SubmitCullPass(const FrameContext &frame);
+    void RecordCullAcquire(VkCommandBuffer commandBuffer,
+                           const FrameContext &frame);
+
+    // Windowed & headless halves of RenderFrame(); the latter has no acquire &
+    // no present
+    void RenderSwapChainFrame();
+    void RenderOffscreenFrame();
+
+    /* For a frame whose fence was reset but whose work never got submitted:
+       an empty submission waits on the semaphores left signaled for it (the
+       acquired image's, the cull pass') and signals the fence, so the next
+       wait on the slot returns
+    */
+    void AbandonFrame(const FrameContext &frame, bool imageAcquired,
+                      bool cullSubmitted);
+
+    // Logs a failed step of a frame; sets mFatalError if nothing can recover
+    void OnFrameError(VkResult result, const char *what);
+
+    /* Write the instance data of this frame into its slot of the ring. The
+       slot's fence must have been waited on. Returns the time spent (ms).
+    */
+    double UpdateInstances(FrameContext &frame);
+
+    /* Read back the GPU timings the slot's previous frame left behind into
+       mLastFrameTimings; the slot's fence must have been waited on
+    */
+    void ReadGpuTimings(uint32_t slot);
+
+    // Pick up the pipeline from the builder; false if it failed to compile
+    bool WaitForGraphicsPipeline();
+
+    /* Kick off a background rebuild when a watched shader changed, and swap
+       in a finished rebuild. Never blocks.
+    */
+    void PollShaderReload();
+
+    /* Rebuild the swap chain, its image views & framebuffers in place, keeping
+       the render pass, pipeline and command pool. Returns false if the frame
+       should be skipped (e.g. the window is minimized).
+    */
+    bool RecreateSwapChain();
+
+    // Destroy retired swap chains whose frames have all completed
+    void ReleaseRetiredSwapChains(bool force);
+
+    // Destroy pipelines replaced by hot reloads once their frames completed
+    void ReleaseRetiredPipelines(bool force);
+
+    // Log achieved frame rate & acquire-to-present latency of the last Loop()
+    void ReportFrameStats();
+
+    // Between frames: end a capture of the first frames, honor F12
+    void UpdateCpuTrace();
+    void WriteCpuTrace();
 
 private:
     // UI
@@ -96,9 +256,15 @@ private:
     int width;
     int height;
 
+    TriSettings mSettings;
+
 private:
+    // Driver host memory; outlives every object created with its callbacks
+    TriHostAllocator mHostAllocator;
+
     // Vulkan
     VkInstance mInstance;
+    uint32_t mInstanceApiVersion;
     std::vector<VkExtensionProperties> mInstanceExtensions;
     std::vector<VkLayerProperties> mInstanceLayers;
 
@@ -115,9 +281,19 @@ private:
     VkQueue mGraphicsQueue;
     VkQueue mPresentQueue;
 
+    // Uploads & GPU culling; the graphics queue unless the device has
+    // dedicated families (see FindQueueFamilies())
+    VkQueue mTransferQueue;
+    VkQueue mComputeQueue;
+
+    // Every buffer & image allocation goes through here
+    TriMemoryAllocator mAllocator;
+
     VkSurfaceKHR mSurface;
 
-    std::vector<VkExtensionProperties> mDeviceExtensions;
+    TriDeviceSelector mDeviceSelector;
+    // Capabilities of mPhysicalDevice
+    TriDeviceProfile mDeviceProfile;
 
     VkSwapchainKHR mSwapChain;
     VkSurfaceFormatKHR mSurfaceFormat;
@@ -125,21 +301,102 @@ private:
     VkExtent2D mSwapExtent;
     std::vector<VkImage> mSwapChainImages;
 
+    // Backing memory of mSwapChainImages when rendering headless
+    std::vector<TriAllocation> mOffscreenImageAllocations;
+
     std::vector<VkImageView> mSwapChainImageViews;
 
+    // Null with dynamic rendering, which needs no framebuffers either
     VkRenderPass mRenderPass;
-    
+    bool mUseDynamicRendering;
+
+    // Persisted across runs to skip shader compilation on warm starts
+    TriPipelineCache mPipelineCache;
+    TriPipelineBuilder mPipelineBuilder;
+    TriPipelineVariantCache mPipelineVariants;
+
     VkPipelineLayout mPipelineLayout;
 
     VkPipeline mGraphicsPipeline;
+    std::shared_future<VkPipeline> mGraphicsPipelineFuture;
+    TriPipelineDesc mGraphicsPipelineDesc;
+
+    // Shader hot reload (--hot-reload)
+    TriShaderWatcher mShaderWatcher;
+    std::vector<std::string> mChangedShaders;
+    std::future<VkPipeline> mReloadPipelineFuture;
+    std::vector<RetiredPipeline> mRetiredPipelines;
+
+    // GPU culling (--gpu-culling); one descriptor set per frame in flight
+    VkDescriptorSetLayout mCullDescriptorSetLayout;
+    VkDescriptorPool mCullDescriptorPool;
+    VkPipelineLayout mCullPipelineLayout;
+    VkPipeline mCullPipeline;
+    std::future<VkPipeline> mCullPipelineFuture;
 
     std::vector<VkFramebuffer> mFramebuffers;
 
     VkCommandPool mCommandPool;
-    VkCommandBuffer mCommandBuffer;
 
-    // Synchronization primitives
-    VkSemaphore mImageAvailableSemaphore;
-    VkSemaphore mRenderFinishedSemaphore;
-    VkFence mInFlightFence;
+    // Compute family pool for async culling; null when it runs on graphics
+    VkCommandPool mComputeCommandPool;
+
+    // Frames-in-flight ring: command buffer, image available semaphore and
+    // in-flight fence for each frame the CPU may record ahead of the GPU
+    std::vector<FrameContext> mFrames;
+    uint32_t mCurrentFrame;
+
+    // Timestamp & pipeline statistics queries, a range per frame in flight
+    TriGpuProfiler mGpuProfiler;
+
+    // Render finished semaphores are tracked per swap chain image, since the
+    // presentation engine holds on to them until that image is re-acquired
+    std::vector<VkSemaphore> mRenderFinishedSemaphores;
+
+    // Geometry, staged into device-local memory at Init()
+    TriUploader mUploader;
+    TriBuffer mVertexBuffer;
+    TriBuffer mIndexBuffer;
+    uint32_t mIndexCount;
+
+    // Bounding radius of the mesh around its origin, for culling
+    float mMeshRadius;
+
+    // Instances drawn from each frame's instance buffer
+    TriStressScene mStressScene;
+
+    // Total number of frames submitted so far
+    uint64_t mFrameNumber;
+
+    // Set on resize or when the surface reports OUT_OF_DATE/SUBOPTIMAL
+    bool mSwapChainDirty;
+    std::vector<RetiredSwapChain> mRetiredSwapChains;
+
+    // A lost device or surface; no later frame can succeed, so IsRunning()
+    // turns false
+    bool mFatalError;
+
+private:
+    // Statistics
+    TriRunningStat mAcquireToPresentStat;
+    // GPU time of the graphics command buffer vs CPU time not spent blocked
+    // on the GPU or the presentation engine, per frame
+    TriRunningStat mGpuFrameStat;
+    TriRunningStat mCpuBusyStat;
+    uint64_t mRenderedFrames;
+    TriClock::time_point mLoopStartTime;
+    TriFrameTimings mLastFrameTimings;
+
+    // Set by F12 & handled before the next frame
+    bool mCpuTraceToggled;
+    // Frame number that ends the running capture; 0 if it runs until stopped
+    uint64_t mCpuTraceEndFrame;
+
+    // Startup cost, reported once the first frame has been rendered
+    TriClock::time_point mInitStartTime;
+    TriStepTimer mInitSteps;
+    // Reads the shaders in while the instance & device are created
+    std::future<void> mShaderPreload;
+    double mPipelineWaitMs;
+    bool mFirstFrameReported;
 };
@@ -0,0 +1,46 @@
+#include "TriBuffer.hpp"
+#include "TriLog.hpp"
+
+VkResult CreateBuffer(TriMemoryAllocator &allocator, VkDeviceSize size,
+                      VkBufferUsageFlags usage, VkMemoryPropertyFlags props,
+                      ETriAllocationStrategy strategy, TriBuffer &buffer)
+{
+    VkBufferCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.size = size;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult result = vkCreateBuffer(allocator.GetDevice(), &createInfo,
+                                     allocator.GetHostAllocator(),
+                                     &buffer.buffer);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create buffer";
+        buffer.buffer = nullptr;
+        return result;
+    }
+
+    result = allocator.AllocateForBuffer(buffer.buffer, props, strategy,
+                                         buffer.allocation);
+    if (result != VK_SUCCESS)
+    {
+        DestroyBuffer(allocator, buffer);
+        return result;
+    }
+
+    buffer.size = size;
+    return VK_SUCCESS;
+}
+
+void DestroyBuffer(TriMemoryAllocator &allocator, TriBuffer &buffer)
+{
+    if (buffer.buffer)
+        vkDestroyBuffer(allocator.GetDevice(), buffer.buffer,
+                        allocator.GetHostAllocator());
+
+    allocator.Free(buffer.allocation);
+
+    buffer = TriBuffer();
+}
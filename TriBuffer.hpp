@@ -0,0 +1,20 @@
+#pragma once
+
+#include "TriMemoryAllocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+// A VkBuffer with memory sub-allocated from a TriMemoryAllocator
+
+struct TriBuffer
+{
+    VkBuffer buffer = nullptr;
+    TriAllocation allocation;
+    VkDeviceSize size = 0;
+};
+
+VkResult CreateBuffer(TriMemoryAllocator &allocator, VkDeviceSize size,
+                      VkBufferUsageFlags usage, VkMemoryPropertyFlags props,
+                      ETriAllocationStrategy strategy, TriBuffer &buffer);
+
+void DestroyBuffer(TriMemoryAllocator &allocator, TriBuffer &buffer);
@@ -0,0 +1,242 @@
+#include "TriCpuProfiler.hpp"
+#include "TriFileUtils.hpp"
+#include "TriLog.hpp"
+
+#if TRI_CPU_PROFILING
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TriCpuEvent
+{
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+/* Written by its thread only. count is published with release after the
+   event is in place, so a writer reading up to count never sees a torn event.
+   A buffer from an older capture is rewound by its thread on its next scope;
+   events are only allocated then.
+*/
+struct TriCpuThreadBuffer
+{
+    std::unique_ptr<TriCpuEvent[]> events;
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> capture{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Trace thread id; ids start at 1
+    uint32_t id = 0;
+
+    // Guarded by gTriCpuTraceMutex
+    std::string name;
+};
+
+std::atomic<bool> gTriCpuTraceCapturing{false};
+
+// Guards the buffer list & serializes starting, stopping & writing captures
+static std::mutex gTriCpuTraceMutex;
+static std::vector<std::unique_ptr<TriCpuThreadBuffer>> gTriCpuBuffers;
+static std::atomic<uint32_t> gTriCpuCapture{0};
+static uint64_t gTriCpuCaptureStart = 0;
+
+// Buffers outlive their threads, so a capture still shows threads that exited
+static TriCpuThreadBuffer *TriCpuThreadBufferGet()
+{
+    thread_local TriCpuThreadBuffer *buffer = nullptr;
+
+    if (!buffer)
+    {
+        std::unique_ptr<TriCpuThreadBuffer> created =
+            std::make_unique<TriCpuThreadBuffer>();
+
+        std::lock_guard<std::mutex> lock(gTriCpuTraceMutex);
+        created->id = static_cast<uint32_t>(gTriCpuBuffers.size()) + 1;
+        buffer = created.get();
+        gTriCpuBuffers.emplace_back(std::move(created));
+    }
+
+    return buffer;
+}
+
+uint64_t TriCpuScope::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void TriCpuScope::Record(const char *name, uint64_t start, uint64_t end)
+{
+    TriCpuThreadBuffer *buffer = TriCpuThreadBufferGet();
+
+    // Pairs with TriCpuTraceStart(): the last write of the buffer is done
+    // before it is rewound
+    uint32_t capture = gTriCpuCapture.load(std::memory_order_acquire);
+
+    if (buffer->capture.load(std::memory_order_relaxed) != capture)
+    {
+        // Threads that never record (or only name themselves) cost nothing
+        if (!buffer->events)
+        {
+            buffer->events =
+                std::make_unique<TriCpuEvent[]>(TRI_CPU_TRACE_EVENTS);
+        }
+
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->capture.store(capture, std::memory_order_release);
+    }
+
+    uint32_t count = buffer->count.load(std::memory_order_relaxed);
+    if (count >= TRI_CPU_TRACE_EVENTS)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[count] = TriCpuEvent{name, start, end - start};
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+bool TriCpuTraceStart()
+{
+    std::lock_guard<std::mutex> lock(gTriCpuTraceMutex);
+
+    gTriCpuCaptureStart = TriCpuScope::Now();
+    gTriCpuCapture.fetch_add(1, std::memory_order_release);
+    gTriCpuTraceCapturing.store(true, std::memory_order_release);
+
+    TriLogVerbose() << "CPU trace started";
+
+    return true;
+}
+
+void TriCpuTraceStop()
+{
+    std::lock_guard<std::mutex> lock(gTriCpuTraceMutex);
+    gTriCpuTraceCapturing.store(false, std::memory_order_release);
+}
+
+bool TriCpuTraceWrite(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(gTriCpuTraceMutex);
+
+    if (gTriCpuTraceCapturing.load(std::memory_order_relaxed))
+    {
+        TriLogWarning() << "CPU trace must be stopped before it is written";
+        return false;
+    }
+
+    uint32_t capture = gTriCpuCapture.load(std::memory_order_relaxed);
+    if (capture == 0)
+        return false;
+
+    std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    uint64_t events = 0;
+    uint64_t dropped = 0;
+    char line[128];
+
+    for (const std::unique_ptr<TriCpuThreadBuffer> &buffer : gTriCpuBuffers)
+    {
+        if (!buffer->name.empty())
+        {
+            std::snprintf(line, sizeof(line),
+                          "{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                          "\"name\": \"thread_name\", \"args\": {\"name\": \"",
+                          buffer->id);
+            json += line;
+            AppendJsonEscaped(json, buffer->name.c_str());
+            json += "\"}},\n";
+        }
+
+        // Threads that recorded nothing this time around
+        if (buffer->capture.load(std::memory_order_acquire) != capture)
+            continue;
+
+        uint32_t count = buffer->count.load(std::memory_order_acquire);
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const TriCpuEvent &event = buffer->events[i];
+
+            // Scopes opened before the capture started are clipped to it
+            uint64_t start = std::max(event.start, gTriCpuCaptureStart);
+            uint64_t end = event.start + event.duration;
+
+            json += "{\"ph\": \"X\", \"pid\": 1, \"tid\": ";
+            json += std::to_string(buffer->id);
+            json += ", \"name\": \"";
+            // Names are literals, but keep the JSON valid whatever they hold
+            AppendJsonEscaped(json, event.name);
+
+            std::snprintf(line, sizeof(line),
+                          "\", \"ts\": %.3f, \"dur\": %.3f},\n",
+                          (start - gTriCpuCaptureStart) / 1000.0,
+                          (end - start) / 1000.0);
+            json += line;
+        }
+
+        events += count;
+    }
+
+    // The last event's trailing comma; the format tolerates none of them
+    if (json.size() >= 2 && json[json.size() - 2] == ',')
+        json.erase(json.size() - 2, 1);
+
+    json += "]}\n";
+
+    if (!WriteBinaryFileAtomic(path, json.data(), json.size()))
+    {
+        TriLogError() << "Failed to write CPU trace to " << path;
+        return false;
+    }
+
+    TriLogInfo() << "Wrote " << events << " CPU trace events to " << path;
+
+    if (dropped != 0)
+    {
+        TriLogWarning() << dropped << " CPU trace events dropped (more than "
+                        << TRI_CPU_TRACE_EVENTS << " on a thread)";
+    }
+
+    return true;
+}
+
+void TriCpuTraceSetThreadName(const char *name)
+{
+    TriCpuThreadBuffer *buffer = TriCpuThreadBufferGet();
+
+    std::lock_guard<std::mutex> lock(gTriCpuTraceMutex);
+    buffer->name = name;
+}
+
+#else
+
+bool TriCpuTraceStart()
+{
+    TriLogWarning() << "Built without CPU profiling (meson option "
+                       "cpu_profiling)";
+    return false;
+}
+
+void TriCpuTraceStop() {}
+
+bool TriCpuTraceWrite(const std::string &path)
+{
+    (void)path;
+    return false;
+}
+
+void TriCpuTraceSetThreadName(const char *name)
+{
+    (void)name;
+}
+
+#endif
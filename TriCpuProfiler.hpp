@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TriConfig.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scopes each thread can record per capture; later ones are dropped
+#define TRI_CPU_TRACE_EVENTS 65536
+
+/* Scoped CPU profiler. TRI_CPU_SCOPE("name") times the rest of the enclosing
+   block while a capture runs; each thread appends to a buffer of its own, so
+   recording takes no locks. TriCpuTraceWrite() dumps the capture in the
+   Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+
+   With the cpu_profiling meson option off the scopes compile to nothing and
+   captures cannot be started.
+*/
+
+// Drops the previous capture. False if profiling is compiled out
+bool TriCpuTraceStart();
+void TriCpuTraceStop();
+
+// The last capture, which must have been stopped; false if nothing was
+// written
+bool TriCpuTraceWrite(const std::string &path);
+
+// Shown in the trace instead of a bare thread id
+void TriCpuTraceSetThreadName(const char *name);
+
+#if TRI_CPU_PROFILING
+
+// Checked by every scope; set between TriCpuTraceStart() & TriCpuTraceStop()
+extern std::atomic<bool> gTriCpuTraceCapturing;
+
+inline bool TriCpuTraceIsCapturing()
+{
+    return gTriCpuTraceCapturing.load(std::memory_order_relaxed);
+}
+
+class TriCpuScope
+{
+public:
+    // name is kept by pointer until the trace is written: use a literal
+    explicit TriCpuScope(const char *name)
+        : mName(name), mStart(TriCpuTraceIsCapturing() ? Now() : 0)
+    {
+    }
+
+    ~TriCpuScope()
+    {
+        if (mStart != 0 && TriCpuTraceIsCapturing())
+            Record(mName, mStart, Now());
+    }
+
+    TriCpuScope(const TriCpuScope &) = delete;
+    TriCpuScope &operator=(const TriCpuScope &) = delete;
+
+public:
+    // Steady clock, in nanoseconds
+    static uint64_t Now();
+
+private:
+    static void Record(const char *name, uint64_t start, uint64_t end);
+
+private:
+    const char *mName;
+    uint64_t mStart;
+};
+
+#define TRI_CPU_SCOPE_CONCAT_(a, b) a##b
+#define TRI_CPU_SCOPE_CONCAT(a, b) TRI_CPU_SCOPE_CONCAT_(a, b)
+
+#define TRI_CPU_SCOPE(name)                                                    \
+    TriCpuScope TRI_CPU_SCOPE_CONCAT(triCpuScope, __LINE__)(name)
+
+#else
+
+inline bool TriCpuTraceIsCapturing() { return false; }
+
+#define TRI_CPU_SCOPE(name) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,339 @@
+#include "TriDeviceSelector.hpp"
+#include "TriFileUtils.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <tuple>
+
+bool TriDeviceProfile::HasExtension(const char *name) const
+{
+    auto position =
+        std::lower_bound(extensions.begin(), extensions.end(), name,
+                         [](const std::string &extension, const char *name)
+                         { return std::strcmp(extension.c_str(), name) < 0; });
+
+    return position != extensions.end() && *position == name;
+}
+
+std::string TriDeviceProfile::UUID() const
+{
+    char hex[VK_UUID_SIZE * 2 + 1];
+
+    for (size_t i = 0; i < VK_UUID_SIZE; i++)
+        std::snprintf(hex + i * 2, 3, "%02x", deviceUUID[i]);
+
+    return hex;
+}
+
+// Higher is preferred; software rasterizers are a last resort, but usable
+static int DeviceTypeRank(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 4;
+
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 3;
+
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 2;
+
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+// Whether left should be picked over right
+static bool Prefer(ETriDevicePolicy policy, const TriDeviceProfile &left,
+                   const TriDeviceProfile &right)
+{
+    auto key = [policy](const TriDeviceProfile &profile)
+    {
+        int typeRank = DeviceTypeRank(profile.props.deviceType);
+        uint32_t asyncFamilies =
+            profile.asyncComputeFamilies + profile.asyncTransferFamilies;
+
+        switch (policy)
+        {
+        case TriDeviceByMemory:
+            return std::make_tuple(profile.deviceLocalBytes,
+                                   static_cast<VkDeviceSize>(typeRank),
+                                   static_cast<VkDeviceSize>(0));
+
+        case TriDeviceByQueues:
+            return std::make_tuple(static_cast<VkDeviceSize>(asyncFamilies),
+                                   static_cast<VkDeviceSize>(typeRank),
+                                   profile.deviceLocalBytes);
+
+        default:
+            return std::make_tuple(static_cast<VkDeviceSize>(typeRank),
+                                   profile.deviceLocalBytes,
+                                   static_cast<VkDeviceSize>(0));
+        }
+    };
+
+    return key(left) > key(right);
+}
+
+static TriDeviceProfile BuildProfile(VkPhysicalDevice device,
+                                     uint32_t instanceApiVersion)
+{
+    TriDeviceProfile profile;
+    profile.device = device;
+    vkGetPhysicalDeviceProperties(device, &profile.props);
+    vkGetPhysicalDeviceFeatures(device, &profile.feats);
+
+    if (std::min(profile.props.apiVersion, instanceApiVersion) >=
+        VK_API_VERSION_1_1)
+    {
+        VkPhysicalDeviceIDProperties idProps{};
+        idProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        idProps.pNext = nullptr;
+
+        VkPhysicalDeviceProperties2 props2{};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &idProps;
+
+        vkGetPhysicalDeviceProperties2(device, &props2);
+        std::memcpy(profile.deviceUUID, idProps.deviceUUID, VK_UUID_SIZE);
+    }
+    else
+    {
+        std::memcpy(profile.deviceUUID, profile.props.pipelineCacheUUID,
+                    VK_UUID_SIZE);
+    }
+
+    uint32_t numExtensions = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &numExtensions,
+                                         nullptr);
+    std::vector<VkExtensionProperties> extensions(numExtensions);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &numExtensions,
+                                         extensions.data());
+
+    profile.extensions.reserve(numExtensions);
+    for (const VkExtensionProperties &extension : extensions)
+        profile.extensions.emplace_back(extension.extensionName);
+
+    std::sort(profile.extensions.begin(), profile.extensions.end());
+
+    VkPhysicalDeviceMemoryProperties memoryProps;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProps);
+
+    for (uint32_t i = 0; i < memoryProps.memoryHeapCount; i++)
+    {
+        const VkMemoryHeap &heap = memoryProps.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            profile.deviceLocalBytes =
+                std::max(profile.deviceLocalBytes, heap.size);
+    }
+
+    uint32_t numFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &numFamilies, nullptr);
+    std::vector<VkQueueFamilyProperties> families(numFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &numFamilies,
+                                             families.data());
+
+    for (const VkQueueFamilyProperties &family : families)
+    {
+        VkQueueFlags flags = family.queueFlags;
+
+        if (flags & VK_QUEUE_GRAPHICS_BIT)
+            continue;
+
+        if (flags & VK_QUEUE_COMPUTE_BIT)
+            profile.asyncComputeFamilies++;
+        else if (flags & VK_QUEUE_TRANSFER_BIT)
+            profile.asyncTransferFamilies++;
+    }
+
+    return profile;
+}
+
+void TriDeviceSelector::Init(VkInstance instance, uint32_t instanceApiVersion,
+                             const std::string &cachePath)
+{
+    mCachePath = cachePath;
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    mProfiles.clear();
+    mProfiles.reserve(deviceCount);
+
+    for (VkPhysicalDevice device : devices)
+    {
+        const TriDeviceProfile &profile =
+            mProfiles.emplace_back(BuildProfile(device, instanceApiVersion));
+
+        TriLogVerbose() << "  " << profile.props.deviceName << " ("
+                        << profile.UUID() << "): "
+                        << profile.deviceLocalBytes / (1024 * 1024)
+                        << " MiB device-local, "
+                        << profile.asyncComputeFamilies
+                        << " async compute & "
+                        << profile.asyncTransferFamilies
+                        << " transfer-only queue families";
+    }
+}
+
+void TriDeviceSelector::Finalize()
+{
+    mProfiles.clear();
+    mCachePath.clear();
+}
+
+const TriDeviceProfile *TriDeviceSelector::Select(ETriDevicePolicy policy,
+                                                  const std::string &uuid,
+                                                  const std::string &filterKey,
+                                                  const Filter &isSuitable)
+{
+    if (policy == TriDeviceByUUID)
+    {
+        const TriDeviceProfile *profile = Find(uuid);
+
+        if (profile && isSuitable(*profile))
+            return profile;
+
+        TriLogWarning() << "No suitable device with UUID " << uuid
+                        << ", falling back to the "
+                        << TriDevicePolicyName(TriDeviceDiscreteFirst)
+                        << " policy";
+        policy = TriDeviceDiscreteFirst;
+    }
+
+    std::string fingerprint = Fingerprint(filterKey);
+
+    /* Same devices, drivers & filter rank and vet the same way, so everything
+       ranked above the last run's choice was unsuitable then; only the
+       choice itself needs vetting again
+    */
+    std::optional<std::string> cachedUUID = LoadCachedUUID(policy, fingerprint);
+    const TriDeviceProfile *cached =
+        cachedUUID.has_value() ? Find(*cachedUUID) : nullptr;
+
+    if (cached && isSuitable(*cached))
+    {
+        TriLogInfo() << "Using the cached device choice: "
+                     << cached->props.deviceName;
+        return cached;
+    }
+
+    std::vector<const TriDeviceProfile *> ranking;
+    for (const TriDeviceProfile &profile : mProfiles)
+        ranking.emplace_back(&profile);
+
+    // Ties keep the enumeration order
+    std::stable_sort(ranking.begin(), ranking.end(),
+                     [policy](const TriDeviceProfile *left,
+                              const TriDeviceProfile *right)
+                     { return Prefer(policy, *left, *right); });
+
+    for (const TriDeviceProfile *profile : ranking)
+    {
+        // Already turned down above
+        if (profile == cached || !isSuitable(*profile))
+            continue;
+
+        StoreCachedUUID(policy, fingerprint, profile->UUID());
+        return profile;
+    }
+
+    return nullptr;
+}
+
+const TriDeviceProfile *TriDeviceSelector::Find(const std::string &uuid) const
+{
+    for (const TriDeviceProfile &profile : mProfiles)
+    {
+        if (profile.UUID() == uuid)
+            return &profile;
+    }
+
+    return nullptr;
+}
+
+// FNV-1a over what identifies each device & its driver, and the filter
+std::string
+TriDeviceSelector::Fingerprint(const std::string &filterKey) const
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    auto mix = [&hash](const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (const TriDeviceProfile &profile : mProfiles)
+    {
+        mix(profile.deviceUUID, VK_UUID_SIZE);
+        mix(&profile.props.vendorID, sizeof(profile.props.vendorID));
+        mix(&profile.props.deviceID, sizeof(profile.props.deviceID));
+        mix(&profile.props.driverVersion, sizeof(profile.props.driverVersion));
+        mix(&profile.props.apiVersion, sizeof(profile.props.apiVersion));
+    }
+
+    mix(filterKey.data(), filterKey.size());
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+                  static_cast<unsigned long long>(hash));
+
+    return hex;
+}
+
+// The cache file is a single line: "<policy> <fingerprint> <uuid>"
+
+std::optional<std::string>
+TriDeviceSelector::LoadCachedUUID(ETriDevicePolicy policy,
+                                  const std::string &fingerprint)
+{
+    if (mCachePath.empty())
+        return std::nullopt;
+
+    std::optional<std::vector<char>> file = ReadBinaryFile(mCachePath);
+    if (!file.has_value())
+        return std::nullopt;
+
+    std::istringstream stream(std::string(file->begin(), file->end()));
+    std::string cachedPolicy;
+    std::string cachedFingerprint;
+    std::string cachedUUID;
+
+    if (!(stream >> cachedPolicy >> cachedFingerprint >> cachedUUID) ||
+        cachedPolicy != TriDevicePolicyName(policy) ||
+        cachedFingerprint != fingerprint)
+        return std::nullopt;
+
+    return cachedUUID;
+}
+
+void TriDeviceSelector::StoreCachedUUID(ETriDevicePolicy policy,
+                                        const std::string &fingerprint,
+                                        const std::string &uuid)
+{
+    if (mCachePath.empty())
+        return;
+
+    std::string line = std::string(TriDevicePolicyName(policy)) + " " +
+                       fingerprint + " " + uuid + "\n";
+
+    if (!WriteBinaryFileAtomic(mCachePath, line.data(), line.size()))
+    {
+        TriLogWarning() << "Failed to save the device choice to "
+                        << mCachePath;
+    }
+}
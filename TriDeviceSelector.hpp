@@ -0,0 +1,95 @@
+#pragma once
+
+#include "TriSettings.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Everything device selection looks at, queried once per physical device
+
+struct TriDeviceProfile
+{
+    VkPhysicalDevice device = nullptr;
+    VkPhysicalDeviceProperties props{};
+    VkPhysicalDeviceFeatures feats{};
+
+    /* VkPhysicalDeviceIDProperties::deviceUUID, which stays the same across
+       runs; 1.0 devices fall back to the pipelineCacheUUID
+    */
+    uint8_t deviceUUID[VK_UUID_SIZE] = {};
+
+    // Sorted, so that lookups are binary searches
+    std::vector<std::string> extensions;
+
+    // Size of the largest DEVICE_LOCAL heap
+    VkDeviceSize deviceLocalBytes = 0;
+
+    // Compute families without graphics, and transfer-only families
+    uint32_t asyncComputeFamilies = 0;
+    uint32_t asyncTransferFamilies = 0;
+
+    bool HasExtension(const char *name) const;
+
+    // deviceUUID as lowercase hex, without dashes
+    std::string UUID() const;
+};
+
+/* Picks the physical device according to an ETriDevicePolicy. Profiles are
+   built once per instance, and devices are always ranked. The choice is
+   written to a small cache file together with a fingerprint of the device
+   set, the drivers & the filter's inputs; while none of them changes, the
+   next run with the same policy vets the cached device alone instead of
+   going down the whole ranking.
+*/
+
+class TriDeviceSelector
+{
+public:
+    // Whether a device can run the app at all (extensions, surface support)
+    using Filter = std::function<bool(const TriDeviceProfile &)>;
+
+    TriDeviceSelector() : mProfiles(), mCachePath() {}
+
+public:
+    // An empty cache path disables persisting the choice
+    void Init(VkInstance instance, uint32_t instanceApiVersion,
+              const std::string &cachePath);
+    void Finalize();
+
+    /* Best suitable device under the policy, or nullptr if none is suitable.
+       TriDeviceByUUID falls back to TriDeviceDiscreteFirst when no suitable
+       device has the given UUID. filterKey names everything isSuitable
+       depends on besides the device itself (e.g. headless & the required
+       extensions); a cached choice made under another key is not reused.
+    */
+    const TriDeviceProfile *Select(ETriDevicePolicy policy,
+                                   const std::string &uuid,
+                                   const std::string &filterKey,
+                                   const Filter &isSuitable);
+
+    const std::vector<TriDeviceProfile> &GetProfiles() const
+    {
+        return mProfiles;
+    }
+
+private:
+    const TriDeviceProfile *Find(const std::string &uuid) const;
+
+    // Changes whenever a device comes or goes, a driver is updated or the
+    // filter's inputs change
+    std::string Fingerprint(const std::string &filterKey) const;
+
+    std::optional<std::string> LoadCachedUUID(ETriDevicePolicy policy,
+                                              const std::string &fingerprint);
+    void StoreCachedUUID(ETriDevicePolicy policy,
+                         const std::string &fingerprint,
+                         const std::string &uuid);
+
+private:
+    std::vector<TriDeviceProfile> mProfiles;
+    std::string mCachePath;
+};
@@ -1,7 +1,18 @@
 #include "TriFileUtils.hpp"
 #include "TriLog.hpp"
 
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 std::optional<std::vector<char> > ReadBinaryFile(const std::string &path)
 {
@@ -31,3 +42,258 @@ std::optional<std::vector<char> > ReadBinaryFile(const std::string &path)
 
     return ret;
 }
+
+#ifndef _WIN32
+// Write all of data to the temporary file & flush it to the disk
+static bool WriteAndSync(const std::string &tmpPath, const void *data,
+                         size_t size)
+{
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+
+    if (fd < 0)
+    {
+        TriLogWarning() << "Failed to open " << tmpPath << " for writing: "
+                        << std::strerror(errno);
+        return false;
+    }
+
+    const char *bytes = static_cast<const char *>(data);
+    size_t written = 0;
+
+    while (written < size)
+    {
+        ssize_t result = write(fd, bytes + written, size - written);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            TriLogWarning() << "Failed to write " << tmpPath << ": "
+                            << std::strerror(errno);
+            close(fd);
+            return false;
+        }
+
+        written += result;
+    }
+
+    // Without this the rename may reach the disk before the data does, and
+    // a crash leaves an empty or truncated file behind
+    if (fsync(fd) != 0)
+    {
+        TriLogWarning() << "Failed to sync " << tmpPath << ": "
+                        << std::strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    if (close(fd) != 0)
+    {
+        TriLogWarning() << "Failed to close " << tmpPath << ": "
+                        << std::strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+// Persist the rename itself; failing to is not fatal, the data is in place
+static void SyncParentDirectory(const std::string &path)
+{
+    size_t separator = path.find_last_of('/');
+    std::string directory = separator == std::string::npos ? "."
+                            : separator == 0 ? "/"
+                                             : path.substr(0, separator);
+
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0)
+        return;
+
+    if (fsync(fd) != 0)
+    {
+        TriLogVerbose() << "Failed to sync directory " << directory << ": "
+                        << std::strerror(errno);
+    }
+
+    close(fd);
+}
+#endif
+
+bool WriteBinaryFileAtomic(const std::string &path, const void *data,
+                           size_t size)
+{
+    std::string tmpPath = path + ".tmp";
+
+#ifndef _WIN32
+    if (!WriteAndSync(tmpPath, data, size))
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+#else
+    {
+        std::ofstream writer(tmpPath, std::ios::binary | std::ios::trunc);
+
+        if (!writer.good())
+        {
+            TriLogWarning() << "Failed to open " << tmpPath << " for writing";
+            return false;
+        }
+
+        writer.write(static_cast<const char *>(data), size);
+        writer.flush();
+
+        if (!writer.good())
+        {
+            TriLogWarning() << "Failed to write " << tmpPath;
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+#endif
+
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        TriLogWarning() << "Failed to rename " << tmpPath << " to " << path;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+#ifndef _WIN32
+    SyncParentDirectory(path);
+#endif
+
+    return true;
+}
+
+TriMappedFile::TriMappedFile(TriMappedFile &&other) noexcept
+    : mData(nullptr), mSize(0), mMapped(false), mBuffer()
+{
+    *this = std::move(other);
+}
+
+TriMappedFile &TriMappedFile::operator=(TriMappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        Unmap();
+
+        mMapped = other.mMapped;
+        mSize = other.mSize;
+        mBuffer = std::move(other.mBuffer);
+        // A moved vector keeps its storage, so this stays valid
+        mData = mMapped ? other.mData : mBuffer.data();
+
+        other.mData = nullptr;
+        other.mSize = 0;
+        other.mMapped = false;
+    }
+
+    return *this;
+}
+
+void TriMappedFile::Unmap()
+{
+#ifndef _WIN32
+    if (mMapped && mData)
+    {
+        munmap(const_cast<char *>(mData), mSize);
+    }
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+    mMapped = false;
+    mBuffer.clear();
+}
+
+std::optional<TriMappedFile> MapFile(const std::string &path)
+{
+    TriMappedFile file;
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        if (info.st_size == 0)
+        {
+            // mmap rejects empty lengths; an empty view is still valid
+            close(fd);
+            return file;
+        }
+
+        void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data != MAP_FAILED)
+        {
+            close(fd);
+
+            file.mData = static_cast<const char *>(data);
+            file.mSize = info.st_size;
+            file.mMapped = true;
+            return file;
+        }
+
+        TriLogVerbose() << "mmap failed for " << path << " ("
+                        << std::strerror(errno) << "), reading instead";
+    }
+
+    // Not mappable (pipe, character device, ...): stream until EOF
+    char chunk[16384];
+    ssize_t bytesRead;
+
+    while ((bytesRead = read(fd, chunk, sizeof(chunk))) != 0)
+    {
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            TriLogWarning() << "Failed to read " << path << ": "
+                            << std::strerror(errno);
+            close(fd);
+            return std::nullopt;
+        }
+
+        file.mBuffer.insert(file.mBuffer.end(), chunk, chunk + bytesRead);
+    }
+
+    close(fd);
+#else
+    std::optional<std::vector<char>> contents = ReadBinaryFile(path);
+
+    if (!contents.has_value())
+    {
+        return std::nullopt;
+    }
+
+    file.mBuffer = std::move(*contents);
+#endif
+
+    file.mData = file.mBuffer.data();
+    file.mSize = file.mBuffer.size();
+    return file;
+}
+
+void AppendJsonEscaped(std::string &out, const char *text)
+{
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out += '\\';
+
+        if (static_cast<unsigned char>(*c) >= 0x20)
+            out += *c;
+    }
+}
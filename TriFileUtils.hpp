@@ -6,3 +6,57 @@
 
 std::optional<std::vector<char> > ReadBinaryFile(const std::string &path);
 
+
+/* Write to a temporary file next to path, then rename it over path so readers
+   never observe a partially written file
+*/
+bool WriteBinaryFileAtomic(const std::string &path, const void *data,
+                           size_t size);
+
+/* Append text to out as the inside of a JSON string: quotes & backslashes
+   are escaped, control characters dropped
+*/
+void AppendJsonEscaped(std::string &out, const char *text);
+
+/* Read-only view of a whole file. Regular files are mmap'ed, so the view is
+   page-aligned and nothing is copied; pipes & other special files are read
+   into a heap buffer instead (aligned for any fundamental type). The view is
+   valid for the lifetime of the object.
+*/
+
+class TriMappedFile
+{
+public:
+    TriMappedFile() : mData(nullptr), mSize(0), mMapped(false), mBuffer() {}
+
+    ~TriMappedFile() { Unmap(); }
+
+    TriMappedFile(const TriMappedFile &) = delete;
+    TriMappedFile &operator=(const TriMappedFile &) = delete;
+
+    TriMappedFile(TriMappedFile &&other) noexcept;
+    TriMappedFile &operator=(TriMappedFile &&other) noexcept;
+
+public:
+    const char *Data() const { return mData; }
+
+    size_t Size() const { return mSize; }
+
+    // False if the contents were streamed into a heap buffer
+    bool IsMapped() const { return mMapped; }
+
+private:
+    friend std::optional<TriMappedFile> MapFile(const std::string &path);
+
+    void Unmap();
+
+private:
+    const char *mData;
+    size_t mSize;
+    bool mMapped;
+
+    // Streaming fallback storage
+    std::vector<char> mBuffer;
+};
+
+std::optional<TriMappedFile> MapFile(const std::string &path);
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+using TriClock = std::chrono::steady_clock;
+
+inline double TriElapsedMs(TriClock::time_point start,
+                           TriClock::time_point end = TriClock::now())
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Constant-space running min/max/mean of a series of samples (milliseconds)
+
+struct TriRunningStat
+{
+    uint64_t count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::max();
+    double max = 0.0;
+
+    void Add(double sample)
+    {
+        count++;
+        sum += sample;
+        min = std::min(min, sample);
+        max = std::max(max, sample);
+    }
+
+    double Min() const { return count == 0 ? 0.0 : min; }
+
+    double Mean() const { return count == 0 ? 0.0 : sum / count; }
+
+    void Reset() { *this = TriRunningStat(); }
+};
+
+// Keeps every sample so that percentiles can be computed; meant for bounded
+// runs such as benchmarks
+
+class TriSampleSeries
+{
+public:
+    void Reserve(size_t count) { mSamples.reserve(count); }
+
+    void Add(double sample)
+    {
+        mSamples.emplace_back(sample);
+        mSorted = false;
+    }
+
+    size_t Count() const { return mSamples.size(); }
+
+    double Min()
+    {
+        Sort();
+        return mSamples.empty() ? 0.0 : mSamples.front();
+    }
+
+    double Max()
+    {
+        Sort();
+        return mSamples.empty() ? 0.0 : mSamples.back();
+    }
+
+    double Mean() const
+    {
+        if (mSamples.empty())
+            return 0.0;
+
+        double sum = 0.0;
+        for (double sample : mSamples)
+            sum += sample;
+
+        return sum / mSamples.size();
+    }
+
+    // Nearest-rank percentile, percentile in [0, 100]
+    double Percentile(double percentile)
+    {
+        if (mSamples.empty())
+            return 0.0;
+
+        Sort();
+
+        double rank = std::ceil(percentile / 100.0 * mSamples.size());
+        size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+
+        return mSamples[std::min(index, mSamples.size() - 1)];
+    }
+
+private:
+    void Sort()
+    {
+        if (!mSorted)
+        {
+            std::sort(mSamples.begin(), mSamples.end());
+            mSorted = true;
+        }
+    }
+
+private:
+    std::vector<double> mSamples;
+    bool mSorted = true;
+};
+
+// Wall-clock breakdown of a sequence of steps, e.g. TriApp::Init()
+
+class TriStepTimer
+{
+public:
+    void Start()
+    {
+        mSteps.clear();
+        mStart = mLast = TriClock::now();
+    }
+
+    // End the current step, which began at the previous Mark() or Start()
+    void Mark(const char *name)
+    {
+        TriClock::time_point now = TriClock::now();
+        mSteps.emplace_back(name, TriElapsedMs(mLast, now));
+        mLast = now;
+    }
+
+    double TotalMs() const { return TriElapsedMs(mStart, mLast); }
+
+    const std::vector<std::pair<std::string, double>> &GetSteps() const
+    {
+        return mSteps;
+    }
+
+private:
+    TriClock::time_point mStart;
+    TriClock::time_point mLast;
+    std::vector<std::pair<std::string, double>> mSteps;
+};
+
+// Where the CPU spent the last RenderFrame() call (milliseconds)
+
+struct TriFrameTimings
+{
+    // Whole RenderFrame() call, stalls included
+    double cpuFrameMs = 0.0;
+
+    // Blocked in vkWaitForFences on the frame slot
+    double fenceWaitMs = 0.0;
+
+    // Inside vkAcquireNextImageKHR & vkQueuePresentKHR (0 when headless)
+    double acquireMs = 0.0;
+    double presentMs = 0.0;
+
+    // Writing this frame's instance data (0 with static instances)
+    double instanceUpdateMs = 0.0;
+
+    // Resetting & recording the command buffer, and the vkQueueSubmit call
+    double recordMs = 0.0;
+    double submitMs = 0.0;
+
+    /* GPU time of the frame submitted framesInFlight frames earlier, if
+       gpuTimed: its graphics command buffer, and the cull (0 without GPU
+       culling) & draw passes. An async cull pass runs on the compute queue,
+       outside of gpuFrameMs.
+    */
+    bool gpuTimed = false;
+    double gpuFrameMs = 0.0;
+    double gpuCullMs = 0.0;
+    double gpuDrawMs = 0.0;
+
+    // False if the frame was skipped, e.g. during swap chain recreation
+    bool rendered = false;
+};
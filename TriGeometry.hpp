@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vertex layout of the mesh pipeline (see Shaders/triangle.vert)
+
+struct TriVertex
+{
+    glm::vec2 position;
+    glm::vec3 color;
+
+    static std::vector<VkVertexInputBindingDescription> GetBindings()
+    {
+        VkVertexInputBindingDescription binding{};
+        binding.binding = 0;
+        binding.stride = sizeof(TriVertex);
+        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return {binding};
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> GetAttributes()
+    {
+        VkVertexInputAttributeDescription position{};
+        position.location = 0;
+        position.binding = 0;
+        position.format = VK_FORMAT_R32G32_SFLOAT;
+        position.offset = offsetof(TriVertex, position);
+
+        VkVertexInputAttributeDescription color{};
+        color.location = 1;
+        color.binding = 0;
+        color.format = VK_FORMAT_R32G32B32_SFLOAT;
+        color.offset = offsetof(TriVertex, color);
+
+        return {position, color};
+    }
+};
+
+// Per-instance data, streamed into a host-visible buffer every frame
+
+struct TriInstance
+{
+    // xy: offset, z: uniform scale, w: rotation (radians)
+    glm::vec4 transform;
+    glm::vec4 color;
+
+    static std::vector<VkVertexInputBindingDescription> GetBindings()
+    {
+        VkVertexInputBindingDescription binding{};
+        binding.binding = 1;
+        binding.stride = sizeof(TriInstance);
+        binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return {binding};
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> GetAttributes()
+    {
+        VkVertexInputAttributeDescription transform{};
+        transform.location = 2;
+        transform.binding = 1;
+        transform.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        transform.offset = offsetof(TriInstance, transform);
+
+        VkVertexInputAttributeDescription color{};
+        color.location = 3;
+        color.binding = 1;
+        color.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        color.offset = offsetof(TriInstance, color);
+
+        return {transform, color};
+    }
+};
+
+// CPU-side indexed mesh, uploaded with TriUploader
+
+struct TriMeshData
+{
+    std::vector<TriVertex> vertices;
+    std::vector<uint32_t> indices;
+};
@@ -0,0 +1,276 @@
+#include "TriGpuProfiler.hpp"
+#include "TriLog.hpp"
+
+#include <cstring>
+
+#define TRI_GPU_PIPELINE_STATS                                                 \
+    (VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |               \
+     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |                    \
+     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |                     \
+     VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+
+VkResult TriGpuProfiler::Init(const VkExtLibary *library,
+                              VkPhysicalDevice physicalDevice, VkDevice device,
+                              const VkAllocationCallbacks *hostAllocator,
+                              uint32_t slotCount, bool pipelineStatistics)
+{
+    Finalize();
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                             nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                             families.data());
+
+    bool anyTimestamps = false;
+    mFamilies.clear();
+
+    for (const VkQueueFamilyProperties &family : families)
+    {
+        uint32_t bits = family.timestampValidBits;
+        anyTimestamps |= bits != 0;
+
+        Family entry{};
+        entry.timestampMask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+        entry.graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        mFamilies.emplace_back(entry);
+    }
+
+    if (!anyTimestamps || props.limits.timestampPeriod <= 0.0f)
+    {
+        TriLogWarning() << "Device has no timestamp queries";
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    mLibrary = library;
+    mDevice = device;
+    mHostAllocator = hostAllocator;
+    mTimestampPeriod = props.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = slotCount * TRI_GPU_MAX_SCOPES * 2;
+
+    VkResult result = vkCreateQueryPool(mDevice, &createInfo, mHostAllocator,
+                                        &mTimestampPool);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create timestamp query pool: " << result;
+        mTimestampPool = nullptr;
+        Finalize();
+        return result;
+    }
+
+    // Statistics are a bonus; timing works without them
+    if (pipelineStatistics)
+    {
+        createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        createInfo.queryCount = slotCount * TRI_GPU_MAX_SCOPES;
+        createInfo.pipelineStatistics = TRI_GPU_PIPELINE_STATS;
+
+        if (vkCreateQueryPool(mDevice, &createInfo, mHostAllocator,
+                              &mStatsPool) != VK_SUCCESS)
+        {
+            TriLogWarning() << "Failed to create pipeline statistics query "
+                               "pool";
+            mStatsPool = nullptr;
+        }
+    }
+
+    mSlots.assign(slotCount, Slot{});
+    for (Slot &slot : mSlots)
+        slot.scopes.reserve(TRI_GPU_MAX_SCOPES);
+
+    mResults.reserve(TRI_GPU_MAX_SCOPES);
+    mCurrentSlot = 0;
+
+    TriLogVerbose() << "GPU profiler: " << slotCount << " slot(s), "
+                    << mTimestampPeriod << " ns per tick, pipeline statistics "
+                    << (mStatsPool ? "on" : "off");
+
+    return VK_SUCCESS;
+}
+
+void TriGpuProfiler::Finalize()
+{
+    if (mStatsPool)
+    {
+        vkDestroyQueryPool(mDevice, mStatsPool, mHostAllocator);
+        mStatsPool = nullptr;
+    }
+
+    if (mTimestampPool)
+    {
+        vkDestroyQueryPool(mDevice, mTimestampPool, mHostAllocator);
+        mTimestampPool = nullptr;
+    }
+
+    mLibrary = nullptr;
+    mDevice = nullptr;
+    mHostAllocator = nullptr;
+    mFamilies.clear();
+    mSlots.clear();
+    mResults.clear();
+}
+
+bool TriGpuProfiler::BeginFrame(uint32_t slotIndex)
+{
+    if (!IsEnabled())
+        return false;
+
+    Slot &slot = mSlots[slotIndex];
+    bool refreshed = slot.submitted && ReadBack(slot, slotIndex);
+
+    slot.scopes.clear();
+    slot.submitted = false;
+    slot.timestampResetPending = true;
+    slot.statsResetPending = true;
+    mCurrentSlot = slotIndex;
+
+    return refreshed;
+}
+
+void TriGpuProfiler::EndFrame()
+{
+    if (IsEnabled())
+        mSlots[mCurrentSlot].submitted = true;
+}
+
+uint32_t TriGpuProfiler::BeginScope(VkCommandBuffer commandBuffer,
+                                    uint32_t queueFamily, const char *name,
+                                    bool statistics)
+{
+    if (!IsEnabled() || queueFamily >= mFamilies.size())
+        return TRI_GPU_NO_SCOPE;
+
+    const Family &family = mFamilies[queueFamily];
+    Slot &slot = mSlots[mCurrentSlot];
+
+    if (family.timestampMask == 0 || slot.scopes.size() >= TRI_GPU_MAX_SCOPES)
+        return TRI_GPU_NO_SCOPE;
+
+    uint32_t scope = static_cast<uint32_t>(slot.scopes.size());
+    uint32_t timestampBase = mCurrentSlot * TRI_GPU_MAX_SCOPES * 2;
+    uint32_t statsBase = mCurrentSlot * TRI_GPU_MAX_SCOPES;
+
+    if (slot.timestampResetPending)
+    {
+        mLibrary->CmdResetQueryPool(commandBuffer, mTimestampPool,
+                                    timestampBase, TRI_GPU_MAX_SCOPES * 2);
+        slot.timestampResetPending = false;
+    }
+
+    // Graphics counters can only be queried from a graphics queue
+    bool stats = statistics && mStatsPool && family.graphics;
+
+    if (stats && slot.statsResetPending)
+    {
+        mLibrary->CmdResetQueryPool(commandBuffer, mStatsPool, statsBase,
+                                    TRI_GPU_MAX_SCOPES);
+        slot.statsResetPending = false;
+    }
+
+    mLibrary->CmdWriteTimestamp(commandBuffer,
+                                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                mTimestampPool, timestampBase + scope * 2);
+
+    if (stats)
+        mLibrary->CmdBeginQuery(commandBuffer, mStatsPool, statsBase + scope,
+                                0);
+
+    slot.scopes.push_back(Scope{name, family.timestampMask, stats});
+
+    return scope;
+}
+
+void TriGpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    if (!IsEnabled() || scope == TRI_GPU_NO_SCOPE)
+        return;
+
+    const Scope &entry = mSlots[mCurrentSlot].scopes[scope];
+
+    if (entry.stats)
+    {
+        mLibrary->CmdEndQuery(commandBuffer, mStatsPool,
+                              mCurrentSlot * TRI_GPU_MAX_SCOPES + scope);
+    }
+
+    mLibrary->CmdWriteTimestamp(
+        commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestampPool,
+        mCurrentSlot * TRI_GPU_MAX_SCOPES * 2 + scope * 2 + 1);
+}
+
+const TriGpuScopeResult *TriGpuProfiler::FindResult(const char *name) const
+{
+    for (const TriGpuScopeResult &result : mResults)
+    {
+        if (std::strcmp(result.name, name) == 0)
+            return &result;
+    }
+
+    return nullptr;
+}
+
+bool TriGpuProfiler::ReadBack(const Slot &slot, uint32_t slotIndex)
+{
+    if (slot.scopes.empty())
+        return false;
+
+    uint64_t timestamps[TRI_GPU_MAX_SCOPES * 2];
+    uint32_t count = static_cast<uint32_t>(slot.scopes.size());
+
+    /* No WAIT_BIT: the fence already covered the frame, so the results are
+       there unless the frame failed to submit, in which case it is dropped
+    */
+    VkResult result = mLibrary->GetQueryPoolResults(
+        mDevice, mTimestampPool, slotIndex * TRI_GPU_MAX_SCOPES * 2, count * 2,
+        sizeof(timestamps), timestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+
+    if (result != VK_SUCCESS)
+        return false;
+
+    mResults.clear();
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Scope &scope = slot.scopes[i];
+
+        TriGpuScopeResult scopeResult;
+        scopeResult.name = scope.name;
+
+        // Only the valid bits count, and they may wrap around
+        uint64_t ticks =
+            (timestamps[i * 2 + 1] - timestamps[i * 2]) & scope.timestampMask;
+        scopeResult.gpuMs = ticks * mTimestampPeriod / 1e6;
+
+        if (scope.stats)
+        {
+            uint64_t counters[4];
+            static_assert(sizeof(counters) == sizeof(TriGpuPipelineStats),
+                          "One counter per statistic bit");
+
+            result = mLibrary->GetQueryPoolResults(
+                mDevice, mStatsPool, slotIndex * TRI_GPU_MAX_SCOPES + i, 1,
+                sizeof(counters), counters, sizeof(counters),
+                VK_QUERY_RESULT_64_BIT);
+
+            if (result == VK_SUCCESS)
+            {
+                std::memcpy(&scopeResult.stats, counters, sizeof(counters));
+                scopeResult.hasStats = true;
+            }
+        }
+
+        mResults.push_back(scopeResult);
+    }
+
+    return true;
+}
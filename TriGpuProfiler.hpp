@@ -0,0 +1,140 @@
+#pragma once
+
+#include "VkExtLibrary.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Scopes a frame may open, across all of its command buffers
+#define TRI_GPU_MAX_SCOPES 8
+
+#define TRI_GPU_NO_SCOPE UINT32_MAX
+
+// Graphics counters of a scope, in VkQueryPipelineStatisticFlagBits order
+struct TriGpuPipelineStats
+{
+    uint64_t vertexInvocations = 0;
+    uint64_t clippingInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentInvocations = 0;
+};
+
+struct TriGpuScopeResult
+{
+    // The literal passed to BeginScope()
+    const char *name = nullptr;
+    double gpuMs = 0.0;
+
+    bool hasStats = false;
+    TriGpuPipelineStats stats;
+};
+
+/* GPU timing on top of VkQueryPool: a pair of timestamps around each named
+   scope &, where the device supports pipeline statistics queries, the
+   graphics counters of the scopes that ask for them. Every frame-in-flight
+   slot owns its own range of queries. BeginFrame() reads back what the slot's
+   previous frame wrote; its fence has been waited on by then, so the read
+   never stalls, and the results are framesInFlight frames old.
+*/
+
+class TriGpuProfiler
+{
+public:
+    TriGpuProfiler()
+        : mLibrary(nullptr), mDevice(nullptr), mHostAllocator(nullptr),
+          mTimestampPool(nullptr), mStatsPool(nullptr), mTimestampPeriod(0.0),
+          mFamilies(), mSlots(), mCurrentSlot(0), mResults()
+    {
+    }
+
+    ~TriGpuProfiler() { Finalize(); }
+
+public:
+    // Statistics are only collected if pipelineStatistics (the device
+    // feature, which must have been enabled) is set
+    VkResult Init(const VkExtLibary *library, VkPhysicalDevice physicalDevice,
+                  VkDevice device, const VkAllocationCallbacks *hostAllocator,
+                  uint32_t slotCount, bool pipelineStatistics);
+
+    // The device must be idle
+    void Finalize();
+
+    bool IsEnabled() const { return mTimestampPool != nullptr; }
+
+    bool HasPipelineStatistics() const { return mStatsPool != nullptr; }
+
+    /* Once the slot's fence has been waited on: read back the slot's previous
+       frame & start recording a new one into it. Returns true if GetResults()
+       was refreshed.
+    */
+    bool BeginFrame(uint32_t slot);
+
+    // Right before the frame's last submission; the scopes of frames that are
+    // never submitted are discarded by the slot's next BeginFrame()
+    void EndFrame();
+
+    /* Outside of render passes only. Records nothing and returns
+       TRI_GPU_NO_SCOPE if queueFamily cannot write timestamps or the frame ran
+       out of scopes; statistics need a graphics family.
+    */
+    uint32_t BeginScope(VkCommandBuffer commandBuffer, uint32_t queueFamily,
+                        const char *name, bool statistics);
+    void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    // Scopes of the last frame read back, in the order they were opened
+    const std::vector<TriGpuScopeResult> &GetResults() const
+    {
+        return mResults;
+    }
+
+    // nullptr if the last frame read back had no such scope
+    const TriGpuScopeResult *FindResult(const char *name) const;
+
+private:
+    struct Family
+    {
+        uint64_t timestampMask;
+        bool graphics;
+    };
+
+    struct Scope
+    {
+        const char *name;
+        uint64_t timestampMask;
+        bool stats;
+    };
+
+    struct Slot
+    {
+        std::vector<Scope> scopes;
+        bool submitted = false;
+
+        // Queries are reset by the frame's first command buffer to use them
+        bool timestampResetPending = true;
+        bool statsResetPending = true;
+    };
+
+private:
+    bool ReadBack(const Slot &slot, uint32_t slotIndex);
+
+private:
+    const VkExtLibary *mLibrary;
+    VkDevice mDevice;
+    const VkAllocationCallbacks *mHostAllocator;
+
+    // TRI_GPU_MAX_SCOPES * 2 timestamps & TRI_GPU_MAX_SCOPES statistics
+    // queries per slot
+    VkQueryPool mTimestampPool;
+    VkQueryPool mStatsPool;
+
+    // Nanoseconds per timestamp tick
+    double mTimestampPeriod;
+
+    std::vector<Family> mFamilies;
+    std::vector<Slot> mSlots;
+    uint32_t mCurrentSlot;
+
+    std::vector<TriGpuScopeResult> mResults;
+};
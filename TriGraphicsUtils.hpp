@@ -1,5 +1,7 @@
 #pragma once
 
+#include "TriBuffer.hpp"
+
 #include <vulkan/vulkan.h>
 
 #include <optional>
@@ -12,9 +14,20 @@ struct QueueFamilyIndices
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
 
-    bool IsComplete()
+    // Dedicated transfer (DMA) & async compute families when the device has
+    // them; otherwise they alias the graphics family
+    std::optional<uint32_t> transferFamily;
+    std::optional<uint32_t> computeFamily;
+
+    bool HasAsyncTransfer() const { return transferFamily != graphicsFamily; }
+
+    bool HasAsyncCompute() const { return computeFamily != graphicsFamily; }
+
+    // Headless rendering has no surface and hence no need to present
+    bool IsComplete(bool requirePresent = true)
     {
-        return graphicsFamily.has_value() && presentFamily.has_value();
+        return graphicsFamily.has_value() &&
+               (!requirePresent || presentFamily.has_value());
     }
 };
 
@@ -24,3 +37,44 @@ struct SwapChainSupportDetails
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> presentModes;
 };
+
+// Per-frame resources of the frames-in-flight ring
+struct FrameContext
+{
+    VkCommandBuffer commandBuffer;
+    VkSemaphore imageAvailableSemaphore;
+    VkFence inFlightFence;
+
+    // Host-visible per-instance data; the fence above guards rewriting it
+    TriBuffer instanceBuffer;
+
+    // GPU culling (--gpu-culling): the compacted instances that survived,
+    // the indirect draw they are drawn with, and the set binding all three
+    TriBuffer visibleInstanceBuffer;
+    TriBuffer drawBuffer;
+    VkDescriptorSet cullDescriptorSet;
+
+    // Culling on an async compute queue: its command buffer, and what the
+    // graphics submission waits on
+    VkCommandBuffer computeCommandBuffer;
+    VkSemaphore cullFinishedSemaphore;
+};
+
+// Swap chain resources kept alive until the frames still using them retire
+struct RetiredSwapChain
+{
+    VkSwapchainKHR swapChain;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+
+    // Value of the frame counter when the swap chain was replaced
+    uint64_t retireFrame;
+};
+
+// Pipeline replaced by a hot reload, destroyed under the same rule as above
+struct RetiredPipeline
+{
+    VkPipeline pipeline;
+    uint64_t retireFrame;
+};
@@ -0,0 +1,362 @@
+#include "TriHostAllocator.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Marks blocks that bypass the pools
+#define TRI_HOST_ALLOC_LARGE TRI_HOST_ALLOC_CLASSES
+
+const char *TriAllocationScopeName(VkSystemAllocationScope scope)
+{
+    switch (scope)
+    {
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+        return "command";
+
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+        return "object";
+
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+        return "cache";
+
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+        return "device";
+
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+        return "instance";
+
+    default:
+        return "unknown";
+    }
+}
+
+static size_t ClassSize(uint16_t sizeClass)
+{
+    return static_cast<size_t>(TRI_HOST_ALLOC_MIN_CLASS) << sizeClass;
+}
+
+// Smallest class that holds bytes, or TRI_HOST_ALLOC_LARGE
+static uint16_t SizeClass(size_t bytes)
+{
+    uint16_t sizeClass = 0;
+    while (sizeClass < TRI_HOST_ALLOC_CLASSES && ClassSize(sizeClass) < bytes)
+        sizeClass++;
+
+    return sizeClass;
+}
+
+static uint8_t ScopeIndex(VkSystemAllocationScope scope)
+{
+    uint32_t index = static_cast<uint32_t>(scope);
+    return static_cast<uint8_t>(
+        std::min<uint32_t>(index, TRI_HOST_ALLOC_SCOPES - 1));
+}
+
+void TriHostAllocator::Init(ETriHostAllocator mode)
+{
+    Finalize();
+
+    for (Stats &stats : mStats)
+    {
+        stats.allocations.store(0, std::memory_order_relaxed);
+        stats.liveAllocations.store(0, std::memory_order_relaxed);
+        stats.liveBytes.store(0, std::memory_order_relaxed);
+        stats.peakBytes.store(0, std::memory_order_relaxed);
+        stats.internalBytes.store(0, std::memory_order_relaxed);
+    }
+
+    mMode = mode;
+
+    mCallbacks = {};
+    mCallbacks.pUserData = this;
+    mCallbacks.pfnAllocation = AllocationCallback;
+    mCallbacks.pfnReallocation = ReallocationCallback;
+    mCallbacks.pfnFree = FreeCallback;
+    mCallbacks.pfnInternalAllocation = InternalAllocationCallback;
+    mCallbacks.pfnInternalFree = InternalFreeCallback;
+}
+
+void TriHostAllocator::Finalize()
+{
+    uint64_t live = 0;
+    for (const Stats &stats : mStats)
+        live += stats.liveAllocations.load(std::memory_order_relaxed);
+
+    // The driver still points into the slabs; leaking them is the lesser evil
+    if (live != 0)
+    {
+        TriLogWarning() << live << " host allocation(s) still live, leaking "
+                        << "the pools";
+    }
+
+    for (Pool &pool : mScopes)
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        if (live == 0)
+        {
+            for (void *slab : pool.slabs)
+                std::free(slab);
+        }
+
+        pool.slabs.clear();
+        std::fill(std::begin(pool.freeLists), std::end(pool.freeLists),
+                  nullptr);
+    }
+
+    mMode = TriHostAllocDriver;
+}
+
+TriHostAllocStats TriHostAllocator::GetStats(
+    VkSystemAllocationScope scope) const
+{
+    const Stats &stats = mStats[ScopeIndex(scope)];
+
+    TriHostAllocStats result;
+    result.allocations = stats.allocations.load(std::memory_order_relaxed);
+    result.liveAllocations =
+        stats.liveAllocations.load(std::memory_order_relaxed);
+    result.liveBytes = stats.liveBytes.load(std::memory_order_relaxed);
+    result.peakBytes = stats.peakBytes.load(std::memory_order_relaxed);
+    result.internalBytes = stats.internalBytes.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+void TriHostAllocator::LogStats() const
+{
+    if (mMode == TriHostAllocDriver)
+        return;
+
+    TriLogInfo() << "Host allocations (" << TriHostAllocatorName(mMode)
+                 << "):";
+
+    for (uint32_t i = 0; i < TRI_HOST_ALLOC_SCOPES; i++)
+    {
+        VkSystemAllocationScope scope = static_cast<VkSystemAllocationScope>(i);
+        TriHostAllocStats stats = GetStats(scope);
+
+        if (stats.allocations == 0 && stats.internalBytes == 0)
+            continue;
+
+        TriLogInfo() << "  " << TriAllocationScopeName(scope) << ": "
+                     << stats.allocations << " allocations, peak "
+                     << stats.peakBytes << " bytes, " << stats.liveBytes
+                     << " bytes live, " << stats.internalBytes
+                     << " bytes driver-internal";
+    }
+}
+
+/* The header sits right before the user pointer, which is aligned within
+   the block. Blocks are at least 16-byte aligned, so size + max(alignment,
+   sizeof(Header)) bytes always fit the header & the aligned allocation.
+*/
+void *TriHostAllocator::Allocate(size_t size, size_t alignment,
+                                 VkSystemAllocationScope scope)
+{
+    static_assert(sizeof(Header) == 16, "Header must keep blocks aligned");
+
+    if (size == 0)
+        return nullptr;
+
+    size_t needed = size + std::max(alignment, sizeof(Header));
+    uint16_t sizeClass = mMode == TriHostAllocPooled ? SizeClass(needed)
+                                                     : TRI_HOST_ALLOC_LARGE;
+    uint8_t scopeIndex = ScopeIndex(scope);
+
+    void *block = sizeClass == TRI_HOST_ALLOC_LARGE
+                      ? std::malloc(needed)
+                      : AllocateBlock(sizeClass, scopeIndex);
+    if (!block)
+        return nullptr;
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(block);
+    uintptr_t user = (start + sizeof(Header) + alignment - 1) &
+                     ~static_cast<uintptr_t>(alignment - 1);
+
+    Header *header = reinterpret_cast<Header *>(user - sizeof(Header));
+    header->size = size;
+    header->sizeClass = sizeClass;
+    header->scope = scopeIndex;
+    header->reserved = 0;
+    header->offset = static_cast<uint32_t>(user - start);
+
+    mStats[scopeIndex].allocations.fetch_add(1, std::memory_order_relaxed);
+    Account(scopeIndex, static_cast<int64_t>(size), 1);
+
+    return reinterpret_cast<void *>(user);
+}
+
+void *TriHostAllocator::Reallocate(void *original, size_t size,
+                                   size_t alignment,
+                                   VkSystemAllocationScope scope)
+{
+    if (!original)
+        return Allocate(size, alignment, scope);
+
+    if (size == 0)
+    {
+        Free(original);
+        return nullptr;
+    }
+
+    Header *header = GetHeader(original);
+
+    // Grow or shrink in place while the block still has room
+    if (header->sizeClass != TRI_HOST_ALLOC_LARGE &&
+        reinterpret_cast<uintptr_t>(original) % alignment == 0 &&
+        header->offset + size <= ClassSize(header->sizeClass))
+    {
+        mStats[header->scope].allocations.fetch_add(1,
+                                                    std::memory_order_relaxed);
+        Account(header->scope,
+                static_cast<int64_t>(size) - static_cast<int64_t>(header->size),
+                0);
+        header->size = size;
+
+        return original;
+    }
+
+    void *memory = Allocate(size, alignment, scope);
+    if (!memory)
+        return nullptr;
+
+    std::memcpy(memory, original, std::min<size_t>(size, header->size));
+    Free(original);
+
+    return memory;
+}
+
+void TriHostAllocator::Free(void *memory)
+{
+    if (!memory)
+        return;
+
+    Header *header = GetHeader(memory);
+    uint16_t sizeClass = header->sizeClass;
+    uint8_t scope = header->scope;
+    void *block = static_cast<char *>(memory) - header->offset;
+
+    Account(scope, -static_cast<int64_t>(header->size), -1);
+
+    if (sizeClass == TRI_HOST_ALLOC_LARGE)
+        std::free(block);
+    else
+        FreeBlock(block, sizeClass, scope);
+}
+
+void *TriHostAllocator::AllocateBlock(uint16_t sizeClass, uint8_t scope)
+{
+    Pool &pool = mScopes[scope];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    void *&freeList = pool.freeLists[sizeClass];
+
+    // Carve a new slab into blocks of this class
+    if (!freeList)
+    {
+        char *slab = static_cast<char *>(std::malloc(TRI_HOST_ALLOC_SLAB_SIZE));
+        if (!slab)
+            return nullptr;
+
+        pool.slabs.push_back(slab);
+
+        size_t blockSize = ClassSize(sizeClass);
+        for (size_t offset = TRI_HOST_ALLOC_SLAB_SIZE; offset >= blockSize;
+             offset -= blockSize)
+        {
+            void *block = slab + offset - blockSize;
+            *static_cast<void **>(block) = freeList;
+            freeList = block;
+        }
+    }
+
+    void *block = freeList;
+    freeList = *static_cast<void **>(block);
+
+    return block;
+}
+
+void TriHostAllocator::FreeBlock(void *block, uint16_t sizeClass,
+                                 uint8_t scope)
+{
+    Pool &pool = mScopes[scope];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    void *&freeList = pool.freeLists[sizeClass];
+    *static_cast<void **>(block) = freeList;
+    freeList = block;
+}
+
+void TriHostAllocator::Account(uint8_t scope, int64_t bytes,
+                               int64_t allocations)
+{
+    Stats &stats = mStats[scope];
+
+    // Negative deltas wrap around to subtractions
+    stats.liveAllocations.fetch_add(static_cast<uint64_t>(allocations),
+                                    std::memory_order_relaxed);
+    uint64_t live =
+        stats.liveBytes.fetch_add(static_cast<uint64_t>(bytes),
+                                  std::memory_order_relaxed) +
+        static_cast<uint64_t>(bytes);
+
+    uint64_t peak = stats.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > 0 && live > peak &&
+           !stats.peakBytes.compare_exchange_weak(peak, live,
+                                                  std::memory_order_relaxed))
+    {
+    }
+}
+
+TriHostAllocator::Header *TriHostAllocator::GetHeader(void *memory)
+{
+    return reinterpret_cast<Header *>(static_cast<char *>(memory) -
+                                      sizeof(Header));
+}
+
+VKAPI_ATTR void *VKAPI_CALL TriHostAllocator::AllocationCallback(
+    void *pUserData, size_t size, size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    return static_cast<TriHostAllocator *>(pUserData)->Allocate(
+        size, alignment, scope);
+}
+
+VKAPI_ATTR void *VKAPI_CALL TriHostAllocator::ReallocationCallback(
+    void *pUserData, void *pOriginal, size_t size, size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    return static_cast<TriHostAllocator *>(pUserData)->Reallocate(
+        pOriginal, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL TriHostAllocator::FreeCallback(void *pUserData,
+                                                          void *pMemory)
+{
+    static_cast<TriHostAllocator *>(pUserData)->Free(pMemory);
+}
+
+VKAPI_ATTR void VKAPI_CALL TriHostAllocator::InternalAllocationCallback(
+    void *pUserData, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)type;
+
+    TriHostAllocator *allocator = static_cast<TriHostAllocator *>(pUserData);
+    allocator->mStats[ScopeIndex(scope)].internalBytes.fetch_add(
+        size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL TriHostAllocator::InternalFreeCallback(
+    void *pUserData, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)type;
+
+    TriHostAllocator *allocator = static_cast<TriHostAllocator *>(pUserData);
+    allocator->mStats[ScopeIndex(scope)].internalBytes.fetch_sub(
+        size, std::memory_order_relaxed);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "TriSettings.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND .. VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+#define TRI_HOST_ALLOC_SCOPES 5
+
+// Pooled size classes: 32, 64, ... 4096 bytes; anything larger is malloc'ed
+#define TRI_HOST_ALLOC_CLASSES 8
+#define TRI_HOST_ALLOC_MIN_CLASS 32
+#define TRI_HOST_ALLOC_SLAB_SIZE (64 * 1024)
+
+const char *TriAllocationScopeName(VkSystemAllocationScope scope);
+
+struct TriHostAllocStats
+{
+    // Allocation & reallocation calls
+    uint64_t allocations = 0;
+
+    uint64_t liveAllocations = 0;
+    uint64_t liveBytes = 0;
+    uint64_t peakBytes = 0;
+
+    // Memory the driver allocated itself & only reported to us
+    uint64_t internalBytes = 0;
+};
+
+/* Driver host memory, handed out through VkAllocationCallbacks. Each
+   allocation scope gets its own size-class pools, so short-lived command
+   scope churn does not fragment the heap that long-lived objects live in.
+   Live & peak usage is tracked per scope in every mode but TriHostAllocDriver,
+   which passes no callbacks at all.
+
+   Every object created with Callbacks() must be destroyed with it as well, so
+   Init() goes before the instance is created & Finalize() after it is gone.
+*/
+
+class TriHostAllocator
+{
+public:
+    TriHostAllocator()
+        : mMode(TriHostAllocDriver), mCallbacks(), mScopes(), mStats()
+    {
+    }
+
+    ~TriHostAllocator() { Finalize(); }
+
+    TriHostAllocator(const TriHostAllocator &) = delete;
+    TriHostAllocator &operator=(const TriHostAllocator &) = delete;
+
+public:
+    void Init(ETriHostAllocator mode);
+
+    // Releases the pools; the statistics stay readable until the next Init()
+    void Finalize();
+
+    // nullptr for TriHostAllocDriver
+    const VkAllocationCallbacks *Callbacks() const
+    {
+        return mMode == TriHostAllocDriver ? nullptr : &mCallbacks;
+    }
+
+    ETriHostAllocator GetMode() const { return mMode; }
+
+    TriHostAllocStats GetStats(VkSystemAllocationScope scope) const;
+
+    void LogStats() const;
+
+private:
+    // Precedes every allocation
+    struct Header
+    {
+        uint64_t size;
+        uint16_t sizeClass;
+        uint8_t scope;
+        uint8_t reserved;
+        // From the start of the block to the user pointer
+        uint32_t offset;
+    };
+
+    struct Pool
+    {
+        std::mutex mutex;
+        // Intrusive free lists, one per size class
+        void *freeLists[TRI_HOST_ALLOC_CLASSES] = {};
+        std::vector<void *> slabs;
+    };
+
+    struct Stats
+    {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> liveAllocations{0};
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> peakBytes{0};
+        std::atomic<uint64_t> internalBytes{0};
+    };
+
+private:
+    void *Allocate(size_t size, size_t alignment,
+                   VkSystemAllocationScope scope);
+    void *Reallocate(void *original, size_t size, size_t alignment,
+                     VkSystemAllocationScope scope);
+    void Free(void *memory);
+
+    void *AllocateBlock(uint16_t sizeClass, uint8_t scope);
+    void FreeBlock(void *block, uint16_t sizeClass, uint8_t scope);
+
+    void Account(uint8_t scope, int64_t bytes, int64_t allocations);
+
+    static Header *GetHeader(void *memory);
+
+    static VKAPI_ATTR void *VKAPI_CALL
+    AllocationCallback(void *pUserData, size_t size, size_t alignment,
+                       VkSystemAllocationScope scope);
+    static VKAPI_ATTR void *VKAPI_CALL
+    ReallocationCallback(void *pUserData, void *pOriginal, size_t size,
+                         size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL FreeCallback(void *pUserData,
+                                                   void *pMemory);
+    static VKAPI_ATTR void VKAPI_CALL
+    InternalAllocationCallback(void *pUserData, size_t size,
+                               VkInternalAllocationType type,
+                               VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL
+    InternalFreeCallback(void *pUserData, size_t size,
+                         VkInternalAllocationType type,
+                         VkSystemAllocationScope scope);
+
+private:
+    ETriHostAllocator mMode;
+    VkAllocationCallbacks mCallbacks;
+    Pool mScopes[TRI_HOST_ALLOC_SCOPES];
+    Stats mStats[TRI_HOST_ALLOC_SCOPES];
+};
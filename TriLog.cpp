@@ -2,6 +2,16 @@
 
 #include "TriConfig.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #if TRI_COLORED_LOG
 #define TRI_COLOR_VERBOSE "\x1b[90m"
 #define TRI_COLOR_INFO "\x1b[92m"
@@ -18,51 +28,450 @@
 
 #endif
 
+// How long the writer thread sleeps when the queue runs dry
+#define TRI_LOG_DRAIN_INTERVAL_MS 5
+
+// Lines written between two flushes of the output
+#define TRI_LOG_BATCH_SIZE 256
+
+struct TriLogRecord
+{
+    ETriLoggerType type = TriLogUnknown;
+    std::string line;
+};
+
+/* Bounded lock-free queue (Vyukov's MPMC ring, drained by a single consumer).
+   Each slot's sequence number tells producers & the consumer whose turn it
+   is, so producers only contend on a single compare-exchange.
+*/
+
+class TriLogQueue
+{
+public:
+    TriLogQueue() : mSlots(), mMask(0), mEnqueuePos(0), mDequeuePos(0) {}
+
+public:
+    void Init(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        mSlots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; i++)
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+
+        mMask = size - 1;
+        mEnqueuePos.store(0, std::memory_order_relaxed);
+        mDequeuePos = 0;
+    }
+
+    // False if the queue is full; record is left untouched then
+    bool TryPush(TriLogRecord &record)
+    {
+        size_t position = mEnqueuePos.load(std::memory_order_relaxed);
+        Slot *slot = nullptr;
+
+        while (true)
+        {
+            slot = &mSlots[position & mMask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) -
+                                  static_cast<intptr_t>(position);
+
+            if (difference == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->record = std::move(record);
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer side only
+    bool TryPop(TriLogRecord &record)
+    {
+        Slot &slot = mSlots[mDequeuePos & mMask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+        if (sequence != mDequeuePos + 1)
+            return false;
+
+        record = std::move(slot.record);
+        slot.sequence.store(mDequeuePos + mMask + 1,
+                            std::memory_order_release);
+        mDequeuePos++;
+
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        TriLogRecord record;
+    };
+
+private:
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask;
+
+    // Producers & the consumer sit on separate cache lines
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) size_t mDequeuePos;
+};
+
+// Writes lines either directly or from a background thread
+
+class TriLogBackend
+{
+public:
+    TriLogBackend()
+        : mQueue(), mThread(), mRunning(false), mAsync(false), mProducers(0),
+          mOverflow(TriLogDrop), mFile(nullptr), mColored(true), mDropped(0),
+          mWakeMutex(), mWake(), mSyncMutex()
+    {
+    }
+
+    ~TriLogBackend() { Stop(); }
+
+public:
+    void Start(const TriLogOptions &options);
+    void Stop();
+
+    void Submit(ETriLoggerType type, std::string &&line);
+
+    bool IsColored() const { return mColored.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+
+    /* Hands the line to the writer (or drops it). False if the writer is
+       not running, in which case the caller writes it itself
+    */
+    bool Enqueue(ETriLoggerType type, std::string &line);
+
+    // Write out up to a batch of queued lines, returns how many
+    size_t Drain();
+
+    void Write(ETriLoggerType type, const std::string &line);
+    void FlushOutputs();
+
+private:
+    TriLogQueue mQueue;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mAsync;
+    // Submit() calls that may still be queueing; Stop() waits for them
+    std::atomic<uint32_t> mProducers;
+    ETriLogOverflow mOverflow;
+
+    // Log file, or nullptr for stdout/stderr
+    FILE *mFile;
+    // Escape codes only go to the console
+    std::atomic<bool> mColored;
+
+    // Lines dropped since the last report
+    std::atomic<uint64_t> mDropped;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+
+    // Serializes synchronous writers
+    std::mutex mSyncMutex;
+};
+
+static TriLogBackend gLogBackend;
+
+void TriLogBackend::Start(const TriLogOptions &options)
+{
+    Stop();
+
+    if (!options.path.empty())
+    {
+        FILE *file = std::fopen(options.path.c_str(), "w");
+
+        if (!file)
+        {
+            TriLogWarning() << "Failed to open log file " << options.path
+                            << ", logging to the console";
+        }
+
+        std::lock_guard<std::mutex> lock(mSyncMutex);
+        mFile = file;
+        mColored.store(file == nullptr, std::memory_order_relaxed);
+    }
+
+    mOverflow = options.overflow;
+
+    if (options.async)
+    {
+        mQueue.Init(options.capacity);
+        mRunning.store(true, std::memory_order_release);
+        mAsync.store(true, std::memory_order_release);
+        mThread = std::thread(&TriLogBackend::Run, this);
+    }
+}
+
+void TriLogBackend::Stop()
+{
+    if (mThread.joinable())
+    {
+        /* New lines are written synchronously from here on. Lines already
+           being queued still reach the writer, which keeps draining (and
+           making room) until they are in
+        */
+        mAsync.store(false);
+        while (mProducers.load() != 0)
+        {
+            mWake.notify_one();
+            std::this_thread::yield();
+        }
+
+        mRunning.store(false, std::memory_order_release);
+        mWake.notify_one();
+        mThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mSyncMutex);
+
+    if (mFile)
+    {
+        std::fclose(mFile);
+        mFile = nullptr;
+        mColored.store(true, std::memory_order_relaxed);
+    }
+}
+
+void TriLogBackend::Submit(ETriLoggerType type, std::string &&line)
+{
+    // Sequentially consistent with Stop(): either it sees this producer, or
+    // this producer sees the writer is going away
+    mProducers.fetch_add(1);
+    bool queued = mAsync.load() && Enqueue(type, line);
+    mProducers.fetch_sub(1);
+
+    if (queued)
+        return;
+
+    std::lock_guard<std::mutex> lock(mSyncMutex);
+    Write(type, line);
+    FlushOutputs();
+}
+
+bool TriLogBackend::Enqueue(ETriLoggerType type, std::string &line)
+{
+    TriLogRecord record;
+    record.type = type;
+    record.line = std::move(line);
+
+    bool mayDrop = mOverflow == TriLogDrop && type < TriLogWarning;
+
+    while (!mQueue.TryPush(record))
+    {
+        if (mayDrop)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Nobody would ever make room
+        if (!mRunning.load(std::memory_order_acquire))
+        {
+            line = std::move(record.line);
+            return false;
+        }
+
+        mWake.notify_one();
+        std::this_thread::yield();
+    }
+
+    // Everything else is picked up on the writer's next poll
+    if (type >= TriLogWarning)
+        mWake.notify_one();
+
+    return true;
+}
+
+void TriLogBackend::Run()
+{
+    while (true)
+    {
+        bool running = mRunning.load(std::memory_order_acquire);
+        size_t written = Drain();
+
+        // Stop() only returns once the queue is empty
+        if (!running && written == 0)
+            break;
+
+        if (written == 0)
+        {
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWake.wait_for(
+                lock, std::chrono::milliseconds(TRI_LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+}
+
+size_t TriLogBackend::Drain()
+{
+    TriLogRecord record;
+    size_t written = 0;
+
+    while (written < TRI_LOG_BATCH_SIZE && mQueue.TryPop(record))
+    {
+        Write(record.type, record.line);
+        written++;
+    }
+
+    uint64_t dropped = mDropped.exchange(0, std::memory_order_relaxed);
+    if (dropped != 0)
+    {
+        std::string line = std::string("[") + TRI_LOG_APP + "] [W] " +
+                           std::to_string(dropped) +
+                           " log line(s) dropped, the queue was full\n";
+        Write(TriLogWarning, line);
+        written++;
+    }
+
+    if (written != 0)
+        FlushOutputs();
+
+    return written;
+}
+
+void TriLogBackend::Write(ETriLoggerType type, const std::string &line)
+{
+    FILE *file = mFile;
+    if (!file)
+        file = type >= TriLogWarning ? stderr : stdout;
+
+    std::fwrite(line.data(), 1, line.size(), file);
+}
+
+void TriLogBackend::FlushOutputs()
+{
+    if (mFile)
+    {
+        std::fflush(mFile);
+        return;
+    }
+
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+void TriLogStart(const TriLogOptions &options)
+{
+    gLogBackend.Start(options);
+}
+
+void TriLogStop()
+{
+    gLogBackend.Stop();
+}
+
+// Streams never leave the thread that formats with them, so the pool needs
+// no locking
+static std::vector<std::unique_ptr<std::ostringstream>> &ThreadStreamPool()
+{
+    thread_local std::vector<std::unique_ptr<std::ostringstream>> pool;
+    return pool;
+}
+
+std::ostringstream *TriLogAcquireStream()
+{
+    std::vector<std::unique_ptr<std::ostringstream>> &pool =
+        ThreadStreamPool();
+
+    if (pool.empty())
+        return new std::ostringstream();
+
+    std::ostringstream *stream = pool.back().release();
+    pool.pop_back();
+
+    return stream;
+}
+
+void TriLogSubmit(ETriLoggerType type, std::ostringstream *stream)
+{
+    gLogBackend.Submit(type, stream->str());
+
+    // Manipulators such as std::hex must not leak into the next line
+    static const std::ostringstream pristine;
+    stream->str(std::string());
+    stream->clear();
+    stream->copyfmt(pristine);
+
+    ThreadStreamPool().emplace_back(stream);
+}
+
+static const char *Color(const char *color)
+{
+    return gLogBackend.IsColored() ? color : "";
+}
+
 // Verbose
 
 template <> void TriLogger<TriLogVerbose>::Tag()
 {
-    std::cout << TRI_COLOR_VERBOSE << "[" << TRI_LOG_APP << "] [D] ";
+    *mStream << Color(TRI_COLOR_VERBOSE) << "[" << TRI_LOG_APP << "] [D] ";
 }
 
 template <> void TriLogger<TriLogVerbose>::Flush()
 {
-    std::cout << TRI_COLOR_RESET << std::endl;
+    *mStream << Color(TRI_COLOR_RESET) << '\n';
+    TriLogSubmit(TriLogVerbose, mStream);
 }
 
 // Info
 
 template <> void TriLogger<TriLogInfo>::Tag()
 {
-    std::cout << TRI_COLOR_INFO << "[" << TRI_LOG_APP << "] [I] ";
+    *mStream << Color(TRI_COLOR_INFO) << "[" << TRI_LOG_APP << "] [I] ";
 }
 
 template <> void TriLogger<TriLogInfo>::Flush()
 {
-    std::cout << TRI_COLOR_RESET << std::endl;
+    *mStream << Color(TRI_COLOR_RESET) << '\n';
+    TriLogSubmit(TriLogInfo, mStream);
 }
 
 // Warning
 
 template <> void TriLogger<TriLogWarning>::Tag()
 {
-    std::cerr << TRI_COLOR_WARNING << "[" << TRI_LOG_APP << "] [W] ";
+    *mStream << Color(TRI_COLOR_WARNING) << "[" << TRI_LOG_APP << "] [W] ";
 }
 
 template <> void TriLogger<TriLogWarning>::Flush()
 {
-    std::cerr << TRI_COLOR_RESET << std::endl;
+    *mStream << Color(TRI_COLOR_RESET) << '\n';
+    TriLogSubmit(TriLogWarning, mStream);
 }
 
 // Error
 
 template <> void TriLogger<TriLogError>::Tag()
 {
-    std::cout << TRI_COLOR_ERROR << "[" << TRI_LOG_APP << "] [E] ";
+    *mStream << Color(TRI_COLOR_ERROR) << "[" << TRI_LOG_APP << "] [E] ";
 }
 
 template <> void TriLogger<TriLogError>::Flush()
 {
-    std::cerr << TRI_COLOR_RESET << std::endl;
+    *mStream << Color(TRI_COLOR_RESET) << '\n';
+    TriLogSubmit(TriLogError, mStream);
 }
-
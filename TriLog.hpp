@@ -1,6 +1,10 @@
 #pragma once
 
-#include <iostream>
+#include "TriConfig.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
 
 #define TRI_LOG_APP "Tri"
 
@@ -14,11 +18,48 @@ enum ETriLoggerType
     TriLogFatal
 };
 
+// What a producer does when the log queue is full
+
+enum ETriLogOverflow
+{
+    TriLogDrop, // Drop verbose & info lines (warnings & errors still wait)
+    TriLogBlock // Wait for the writer thread to make room
+};
+
+struct TriLogOptions
+{
+    // Write from a background thread; false writes (and flushes) every line
+    // on the logging thread
+    bool async = true;
+
+    // Log file; empty logs to stdout (verbose, info) & stderr (the rest)
+    std::string path;
+
+    ETriLogOverflow overflow = TriLogDrop;
+
+    // Lines the queue holds; rounded up to a power of two
+    size_t capacity = 8192;
+};
+
+/* Until TriLogStart() is called, lines are written synchronously to
+   stdout/stderr. TriLogStop() writes out whatever is queued and returns to
+   that mode; it also runs at exit.
+*/
+void TriLogStart(const TriLogOptions &options);
+void TriLogStop();
+
+// Formatting streams are pooled per thread, so a line costs no allocation
+// beyond its own text
+std::ostringstream *TriLogAcquireStream();
+
+// Hand the line over to the backend & return the stream to the pool
+void TriLogSubmit(ETriLoggerType type, std::ostringstream *stream);
+
 template <ETriLoggerType type>
 class TriLogger
 {
 public:
-    TriLogger()
+    TriLogger() : mStream(TriLogAcquireStream())
     {
         Tag();
     }
@@ -28,6 +69,9 @@ public:
         Flush();
     }
 
+    TriLogger(const TriLogger &) = delete;
+    TriLogger &operator=(const TriLogger &) = delete;
+
     template <typename T>
     TriLogger &operator<<(const T &message)
     {
@@ -39,11 +83,14 @@ private:
     {
         static_assert(type == TriLogUnknown, "Must specialize");
     }
-    
+
     void Flush()
     {
         static_assert(type == TriLogUnknown, "Must specialize");
     }
+
+private:
+    std::ostringstream *mStream;
 };
 
 // Verbose
@@ -55,7 +102,7 @@ template <>
 template <typename T>
 TriLogger<TriLogVerbose> &TriLogger<TriLogVerbose>::operator<<(const T &message)
 {
-    std::cout << message;
+    *mStream << message;
     return *this;
 }
 
@@ -68,7 +115,7 @@ template <>
 template <typename T>
 TriLogger<TriLogInfo> &TriLogger<TriLogInfo>::operator<<(const T &message)
 {
-    std::cout << message;
+    *mStream << message;
     return *this;
 }
 
@@ -81,7 +128,7 @@ template <>
 template <typename T>
 TriLogger<TriLogWarning> &TriLogger<TriLogWarning>::operator<<(const T &message)
 {
-    std::cerr << message;
+    *mStream << message;
     return *this;
 }
 
@@ -94,12 +141,32 @@ template <>
 template <typename T>
 TriLogger<TriLogError> &TriLogger<TriLogError>::operator<<(const T &message)
 {
-    std::cerr << message;
+    *mStream << message;
     return *this;
 }
 
 
-#define TriLogVerbose() TriLogger<TriLogVerbose>()
-#define TriLogInfo() TriLogger<TriLogInfo>()
-#define TriLogWarning() TriLogger<TriLogWarning>()
-#define TriLogError() TriLogger<TriLogError>()
+// Levels below the log_level meson option are compiled out
+template <ETriLoggerType type>
+constexpr bool TriLogEnabled = type >= TRI_MIN_LOG_LEVEL;
+
+// Swallows a finished << chain; & binds looser than << but tighter than ?:
+struct TriLogVoidify
+{
+    template <ETriLoggerType type>
+    void operator&(const TriLogger<type> &) const
+    {
+    }
+};
+
+/* A disabled level short-circuits on a constant: the << chain is still
+   type-checked, but its arguments are never evaluated and no code is emitted
+   for it. Being a single expression, it nests under an unbraced if/else.
+*/
+#define TRI_LOG_IF(type)                                                       \
+    !TriLogEnabled<type> ? (void)0 : TriLogVoidify() & TriLogger<type>()
+
+#define TriLogVerbose() TRI_LOG_IF(TriLogVerbose)
+#define TriLogInfo() TRI_LOG_IF(TriLogInfo)
+#define TriLogWarning() TRI_LOG_IF(TriLogWarning)
+#define TriLogError() TRI_LOG_IF(TriLogError)
@@ -0,0 +1,653 @@
+#include "TriMemoryAllocator.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+
+#define TRI_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+
+struct TriMemoryBlock
+{
+    struct Used
+    {
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+        ETriResourceKind kind;
+    };
+
+    VkDeviceMemory memory = nullptr;
+    VkDeviceSize size = 0;
+    uint32_t memoryType = 0;
+    char *mapped = nullptr;
+    ETriAllocationStrategy strategy = TriAllocFreeList;
+
+    // Free ranges (offset -> size), free-list strategy only
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+
+    // Live allocations (offset -> size & kind)
+    std::map<VkDeviceSize, Used> used;
+
+    // Bump pointer, linear strategy only
+    VkDeviceSize linearOffset = 0;
+
+    VkDeviceSize usedBytes = 0;
+};
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return alignment <= 1 ? value
+                          : (value + alignment - 1) / alignment * alignment;
+}
+
+TriMemoryAllocator::TriMemoryAllocator()
+    : mPhysicalDevice(nullptr), mDevice(nullptr), mHostAllocator(nullptr),
+      mMemProps(), mGranularity(1), mBlockSize(0), mBlocks(),
+      mDedicatedCount(), mDedicatedBytes(), mMutex()
+{
+}
+
+TriMemoryAllocator::~TriMemoryAllocator() { Finalize(); }
+
+void TriMemoryAllocator::Init(VkPhysicalDevice physicalDevice,
+                              VkDevice device,
+                              const VkAllocationCallbacks *hostAllocator,
+                              VkDeviceSize blockSize)
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    mPhysicalDevice = physicalDevice;
+    mDevice = device;
+    mHostAllocator = hostAllocator;
+
+    vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &mMemProps);
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &props);
+    mGranularity = std::max<VkDeviceSize>(props.limits.bufferImageGranularity,
+                                          1);
+
+    mBlockSize = blockSize != 0 ? blockSize : TRI_DEFAULT_BLOCK_SIZE;
+
+    mDedicatedCount.assign(mMemProps.memoryTypeCount, 0);
+    mDedicatedBytes.assign(mMemProps.memoryTypeCount, 0);
+
+    TriLogVerbose() << "Memory allocator: " << (mBlockSize >> 20)
+                    << " MiB blocks, bufferImageGranularity " << mGranularity
+                    << ", maxMemoryAllocationCount "
+                    << props.limits.maxMemoryAllocationCount;
+}
+
+void TriMemoryAllocator::Finalize()
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    for (std::unique_ptr<TriMemoryBlock> &block : mBlocks)
+    {
+        if (!block->used.empty())
+        {
+            TriLogWarning() << "Memory block freed with "
+                            << block->used.size() << " live allocation(s)";
+        }
+
+        DestroyBlock(*block);
+    }
+
+    mBlocks.clear();
+    mDedicatedCount.clear();
+    mDedicatedBytes.clear();
+    mDevice = nullptr;
+    mHostAllocator = nullptr;
+    mPhysicalDevice = nullptr;
+}
+
+VkResult TriMemoryAllocator::Allocate(const VkMemoryRequirements &reqs,
+                                      VkMemoryPropertyFlags props,
+                                      ETriResourceKind kind,
+                                      ETriAllocationStrategy strategy,
+                                      TriAllocation &allocation)
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    uint32_t memoryType = mMemProps.memoryTypeCount;
+    for (uint32_t i = 0; i < mMemProps.memoryTypeCount; i++)
+    {
+        if ((reqs.memoryTypeBits & (1u << i)) &&
+            (mMemProps.memoryTypes[i].propertyFlags & props) == props)
+        {
+            memoryType = i;
+            break;
+        }
+    }
+
+    if (memoryType == mMemProps.memoryTypeCount)
+    {
+        TriLogError() << "No memory type with properties " << props;
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    allocation = TriAllocation();
+    allocation.memoryType = memoryType;
+    allocation.size = reqs.size;
+
+    // Large resources would waste most of a block, give them their own. The
+    // block the heap would get counts, not the nominal block size.
+    if (reqs.size > BlockSizeFor(memoryType) / 2)
+        return AllocateDedicated(reqs, allocation);
+
+    VkDeviceSize offset = 0;
+    TriMemoryBlock *target = nullptr;
+
+    for (std::unique_ptr<TriMemoryBlock> &block : mBlocks)
+    {
+        if (block->memoryType == memoryType && block->strategy == strategy &&
+            AllocateFromBlock(*block, reqs.size, reqs.alignment, kind,
+                              block->size, offset))
+        {
+            target = block.get();
+            break;
+        }
+    }
+
+    if (!target)
+    {
+        VkResult result = CreateBlock(memoryType, strategy, target);
+
+        if (result != VK_SUCCESS)
+            return result;
+
+        // Alignment or granularity padding can still overflow a fresh block;
+        // do not keep it around empty
+        if (!AllocateFromBlock(*target, reqs.size, reqs.alignment, kind,
+                               target->size, offset))
+        {
+            DestroyBlock(*target);
+            mBlocks.pop_back();
+
+            return AllocateDedicated(reqs, allocation);
+        }
+    }
+
+    allocation.memory = target->memory;
+    allocation.offset = offset;
+    allocation.block = target;
+    allocation.mapped = target->mapped ? target->mapped + offset : nullptr;
+
+    return VK_SUCCESS;
+}
+
+void TriMemoryAllocator::Free(TriAllocation &allocation)
+{
+    if (!allocation.memory)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    if (!allocation.block)
+    {
+        if (allocation.mapped)
+            vkUnmapMemory(mDevice, allocation.memory);
+
+        vkFreeMemory(mDevice, allocation.memory, mHostAllocator);
+        mDedicatedCount[allocation.memoryType]--;
+        mDedicatedBytes[allocation.memoryType] -= allocation.size;
+    }
+    else
+    {
+        FreeInBlock(*allocation.block, allocation.offset);
+
+        // Keep one spare block around so alloc/free cycles do not thrash
+        if (allocation.block->used.empty())
+            ReleaseEmptyBlocks(true);
+    }
+
+    allocation = TriAllocation();
+}
+
+VkResult TriMemoryAllocator::AllocateForBuffer(VkBuffer buffer,
+                                               VkMemoryPropertyFlags props,
+                                               ETriAllocationStrategy strategy,
+                                               TriAllocation &allocation)
+{
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(mDevice, buffer, &reqs);
+
+    VkResult result =
+        Allocate(reqs, props, TriResourceLinear, strategy, allocation);
+    if (result != VK_SUCCESS)
+        return result;
+
+    result = vkBindBufferMemory(mDevice, buffer, allocation.memory,
+                                allocation.offset);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to bind buffer memory";
+        Free(allocation);
+    }
+
+    return result;
+}
+
+VkResult TriMemoryAllocator::AllocateForImage(VkImage image,
+                                              VkMemoryPropertyFlags props,
+                                              TriAllocation &allocation)
+{
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(mDevice, image, &reqs);
+
+    VkResult result = Allocate(reqs, props, TriResourceOptimal,
+                               TriAllocFreeList, allocation);
+    if (result != VK_SUCCESS)
+        return result;
+
+    result = vkBindImageMemory(mDevice, image, allocation.memory,
+                               allocation.offset);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to bind image memory";
+        Free(allocation);
+    }
+
+    return result;
+}
+
+uint32_t TriMemoryAllocator::Defragment(const TriDefragMoveFn &move)
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    uint32_t moves = 0;
+
+    // The hook must not allocate from here, which could grow mBlocks
+    for (std::unique_ptr<TriMemoryBlock> &block : mBlocks)
+    {
+        if (block->strategy != TriAllocFreeList)
+            continue;
+
+        // Snapshot, since moving modifies the map
+        std::vector<std::pair<VkDeviceSize, TriMemoryBlock::Used>> live(
+            block->used.begin(), block->used.end());
+
+        for (const auto &entry : live)
+        {
+            VkDeviceSize from = entry.first;
+            VkDeviceSize to = 0;
+
+            // Only worth it if there is room strictly below the allocation
+            if (!AllocateFromBlock(*block, entry.second.size,
+                                   entry.second.alignment, entry.second.kind,
+                                   from, to))
+            {
+                continue;
+            }
+
+            TriAllocation source;
+            source.memory = block->memory;
+            source.offset = from;
+            source.size = entry.second.size;
+            source.mapped = block->mapped ? block->mapped + from : nullptr;
+            source.memoryType = block->memoryType;
+            source.block = block.get();
+
+            TriAllocation destination = source;
+            destination.offset = to;
+            destination.mapped = block->mapped ? block->mapped + to : nullptr;
+
+            if (move(source, destination))
+            {
+                FreeInBlock(*block, from);
+                moves++;
+            }
+            else
+            {
+                FreeInBlock(*block, to);
+            }
+        }
+    }
+
+    ReleaseEmptyBlocks(false);
+
+    if (moves > 0)
+    {
+        TriLogVerbose() << "Defragmentation moved " << moves
+                        << " allocation(s)";
+    }
+
+    return moves;
+}
+
+TriMemoryHeapStats TriMemoryAllocator::GetHeapStats(uint32_t heapIndex)
+{
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+
+    TriMemoryHeapStats stats;
+
+    if (heapIndex >= mMemProps.memoryHeapCount)
+        return stats;
+
+    stats.heapSize = mMemProps.memoryHeaps[heapIndex].size;
+
+    for (const std::unique_ptr<TriMemoryBlock> &block : mBlocks)
+    {
+        if (mMemProps.memoryTypes[block->memoryType].heapIndex != heapIndex)
+            continue;
+
+        stats.blockCount++;
+        stats.allocationCount += block->used.size();
+        stats.reservedBytes += block->size;
+        stats.usedBytes += block->usedBytes;
+    }
+
+    for (uint32_t i = 0; i < mDedicatedCount.size(); i++)
+    {
+        if (mMemProps.memoryTypes[i].heapIndex != heapIndex)
+            continue;
+
+        stats.allocationCount += mDedicatedCount[i];
+        stats.reservedBytes += mDedicatedBytes[i];
+        stats.usedBytes += mDedicatedBytes[i];
+    }
+
+    return stats;
+}
+
+void TriMemoryAllocator::LogStats()
+{
+    for (uint32_t i = 0; i < GetHeapCount(); i++)
+    {
+        TriMemoryHeapStats stats = GetHeapStats(i);
+
+        if (stats.reservedBytes == 0)
+            continue;
+
+        TriLogInfo() << "Memory heap #" << i << ": " << stats.allocationCount
+                     << " allocation(s) in " << stats.blockCount
+                     << " block(s), " << (stats.usedBytes >> 10) << " / "
+                     << (stats.reservedBytes >> 10) << " KiB used, heap "
+                     << (stats.heapSize >> 20) << " MiB";
+    }
+}
+
+bool TriMemoryAllocator::AllocateFromBlock(TriMemoryBlock &block,
+                                           VkDeviceSize size,
+                                           VkDeviceSize alignment,
+                                           ETriResourceKind kind,
+                                           VkDeviceSize maxOffset,
+                                           VkDeviceSize &offset)
+{
+    if (block.strategy == TriAllocLinear)
+    {
+        VkDeviceSize start = AlignUp(block.linearOffset, alignment);
+
+        if (!block.used.empty())
+        {
+            auto last = block.used.rbegin();
+            if (last->second.kind != kind &&
+                OnSamePage(last->first + last->second.size - 1, start))
+            {
+                start = AlignUp(start, mGranularity);
+            }
+        }
+
+        if (start + size > block.size || start >= maxOffset)
+            return false;
+
+        block.linearOffset = start + size;
+        block.used[start] = {size, alignment, kind};
+        block.usedBytes += size;
+        offset = start;
+        return true;
+    }
+
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end();
+         it++)
+    {
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+
+        if (rangeStart >= maxOffset)
+            break;
+
+        VkDeviceSize start = AlignUp(rangeStart, alignment);
+
+        // Linear & optimal resources must not share a granularity page
+        auto next = block.used.lower_bound(rangeStart);
+        if (next != block.used.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->second.kind != kind &&
+                OnSamePage(prev->first + prev->second.size - 1, start))
+            {
+                start = AlignUp(start, mGranularity);
+            }
+        }
+
+        VkDeviceSize end = start + size;
+
+        if (end > rangeEnd || start >= maxOffset)
+            continue;
+
+        if (next != block.used.end() && next->second.kind != kind &&
+            OnSamePage(end - 1, next->first))
+        {
+            continue;
+        }
+
+        block.freeRanges.erase(it);
+
+        if (start > rangeStart)
+            block.freeRanges[rangeStart] = start - rangeStart;
+
+        if (rangeEnd > end)
+            block.freeRanges[end] = rangeEnd - end;
+
+        block.used[start] = {size, alignment, kind};
+        block.usedBytes += size;
+        offset = start;
+        return true;
+    }
+
+    return false;
+}
+
+void TriMemoryAllocator::FreeInBlock(TriMemoryBlock &block, VkDeviceSize offset)
+{
+    auto it = block.used.find(offset);
+
+    if (it == block.used.end())
+    {
+        TriLogWarning() << "Freeing unknown allocation at offset " << offset;
+        return;
+    }
+
+    VkDeviceSize size = it->second.size;
+    block.used.erase(it);
+    block.usedBytes -= size;
+
+    if (block.strategy == TriAllocLinear)
+    {
+        if (block.used.empty())
+            block.linearOffset = 0;
+
+        return;
+    }
+
+    // Return the range, merging with free neighbours on both sides
+    VkDeviceSize start = offset;
+    VkDeviceSize end = offset + size;
+
+    auto next = block.freeRanges.lower_bound(start);
+    if (next != block.freeRanges.end() && next->first == end)
+    {
+        end += next->second;
+        next = block.freeRanges.erase(next);
+    }
+
+    if (next != block.freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start)
+        {
+            start = prev->first;
+            block.freeRanges.erase(prev);
+        }
+    }
+
+    block.freeRanges[start] = end - start;
+}
+
+VkDeviceSize TriMemoryAllocator::BlockSizeFor(uint32_t memoryType) const
+{
+    uint32_t heapIndex = mMemProps.memoryTypes[memoryType].heapIndex;
+
+    // Small heaps (e.g. 256 MiB BAR) get proportionally smaller blocks
+    VkDeviceSize size = std::min(mBlockSize,
+                                 mMemProps.memoryHeaps[heapIndex].size / 8);
+    return std::max<VkDeviceSize>(size, 1024 * 1024);
+}
+
+VkResult TriMemoryAllocator::AllocateDedicated(const VkMemoryRequirements &reqs,
+                                               TriAllocation &allocation)
+{
+    uint32_t memoryType = allocation.memoryType;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.allocationSize = reqs.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkResult result = vkAllocateMemory(mDevice, &allocInfo, mHostAllocator,
+                                       &allocation.memory);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to allocate " << reqs.size
+                      << " bytes of dedicated memory";
+        allocation.memory = nullptr;
+        return result;
+    }
+
+    if (mMemProps.memoryTypes[memoryType].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        result = vkMapMemory(mDevice, allocation.memory, 0, VK_WHOLE_SIZE, 0,
+                             &allocation.mapped);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to map " << reqs.size
+                          << " bytes of dedicated memory";
+            vkFreeMemory(mDevice, allocation.memory, mHostAllocator);
+            allocation.memory = nullptr;
+            allocation.mapped = nullptr;
+            return result;
+        }
+    }
+
+    mDedicatedCount[memoryType]++;
+    mDedicatedBytes[memoryType] += reqs.size;
+    return VK_SUCCESS;
+}
+
+VkResult TriMemoryAllocator::CreateBlock(uint32_t memoryType,
+                                         ETriAllocationStrategy strategy,
+                                         TriMemoryBlock *&created)
+{
+    VkDeviceSize size = BlockSizeFor(memoryType);
+
+    std::unique_ptr<TriMemoryBlock> block = std::make_unique<TriMemoryBlock>();
+    block->size = size;
+    block->memoryType = memoryType;
+    block->strategy = strategy;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkResult result =
+        vkAllocateMemory(mDevice, &allocInfo, mHostAllocator, &block->memory);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to allocate a " << (size >> 20)
+                      << " MiB memory block";
+        return result;
+    }
+
+    if (mMemProps.memoryTypes[memoryType].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void *mapped = nullptr;
+        result = vkMapMemory(mDevice, block->memory, 0, VK_WHOLE_SIZE, 0,
+                             &mapped);
+        if (result != VK_SUCCESS)
+        {
+            TriLogError() << "Failed to map a " << (size >> 20)
+                          << " MiB memory block";
+            vkFreeMemory(mDevice, block->memory, mHostAllocator);
+            return result;
+        }
+
+        block->mapped = static_cast<char *>(mapped);
+    }
+
+    if (strategy == TriAllocFreeList)
+        block->freeRanges[0] = size;
+
+    TriLogVerbose() << "New " << (size >> 20) << " MiB memory block (type "
+                    << memoryType << ", "
+                    << (strategy == TriAllocLinear ? "linear" : "free list")
+                    << ")";
+
+    mBlocks.emplace_back(std::move(block));
+    created = mBlocks.back().get();
+    return VK_SUCCESS;
+}
+
+void TriMemoryAllocator::ReleaseEmptyBlocks(bool keepOne)
+{
+    auto it = mBlocks.begin();
+    while (it != mBlocks.end())
+    {
+        TriMemoryBlock &block = **it;
+        bool release = block.used.empty();
+
+        if (release && keepOne)
+        {
+            // Only release if another block of the same kind remains
+            release = std::any_of(
+                mBlocks.begin(), mBlocks.end(),
+                [&](const std::unique_ptr<TriMemoryBlock> &other)
+                {
+                    return other.get() != &block &&
+                           other->memoryType == block.memoryType &&
+                           other->strategy == block.strategy;
+                });
+        }
+
+        if (release)
+        {
+            DestroyBlock(block);
+            it = mBlocks.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void TriMemoryAllocator::DestroyBlock(TriMemoryBlock &block)
+{
+    if (block.mapped)
+        vkUnmapMemory(mDevice, block.memory);
+
+    vkFreeMemory(mDevice, block.memory, mHostAllocator);
+    block.memory = nullptr;
+    block.mapped = nullptr;
+}
+
+bool TriMemoryAllocator::OnSamePage(VkDeviceSize lastByteOfA,
+                                    VkDeviceSize firstByteOfB) const
+{
+    // Granularity is a power of two (Vulkan spec, "Buffer-Image Granularity")
+    VkDeviceSize pageMask = ~(mGranularity - 1);
+    return (lastByteOfA & pageMask) == (firstByteOfB & pageMask);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* Sub-allocation strategies of a memory block:
+
+   - Free list: general purpose; first fit over a sorted list of free ranges,
+     neighbours are merged again on free.
+   - Linear: bump allocation for short-lived resources (e.g. staging); the
+     block rewinds once everything allocated from it has been freed.
+*/
+
+enum ETriAllocationStrategy
+{
+    TriAllocFreeList,
+    TriAllocLinear
+};
+
+/* bufferImageGranularity only separates linear resources (buffers, linear
+   images) from optimal-tiling images
+*/
+
+enum ETriResourceKind
+{
+    TriResourceLinear,
+    TriResourceOptimal
+};
+
+struct TriMemoryBlock;
+
+struct TriAllocation
+{
+    VkDeviceMemory memory = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    // Persistently mapped pointer (offset applied) for host-visible memory
+    void *mapped = nullptr;
+
+    uint32_t memoryType = 0;
+
+    // Owning block; nullptr for dedicated allocations
+    TriMemoryBlock *block = nullptr;
+};
+
+struct TriMemoryHeapStats
+{
+    uint64_t blockCount = 0;
+    uint64_t allocationCount = 0;
+
+    // Memory obtained from the driver, and how much of it is handed out
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+
+    VkDeviceSize heapSize = 0;
+};
+
+/* Defragmentation hook: move the resource bound to `from` into `to` (copy
+   the contents, re-create and re-bind the resource) and update any copies
+   of the allocation. Returning false cancels the move.
+*/
+using TriDefragMoveFn =
+    std::function<bool(const TriAllocation &from, const TriAllocation &to)>;
+
+/* Device memory allocator that reserves large blocks per memory type and
+   sub-allocates from them, keeping us far below maxMemoryAllocationCount.
+   Requests larger than half of their heap's block size (see BlockSizeFor())
+   get a dedicated allocation instead.
+   Thread-safe.
+*/
+
+class TriMemoryAllocator
+{
+public:
+    // Out of line, TriMemoryBlock is only complete in the .cpp
+    TriMemoryAllocator();
+    ~TriMemoryAllocator();
+
+    TriMemoryAllocator(const TriMemoryAllocator &) = delete;
+    TriMemoryAllocator &operator=(const TriMemoryAllocator &) = delete;
+
+public:
+    /* A blockSize of 0 picks 64 MiB (less on small heaps). Buffers created
+       through the allocator use hostAllocator as well.
+    */
+    void Init(VkPhysicalDevice physicalDevice, VkDevice device,
+              const VkAllocationCallbacks *hostAllocator,
+              VkDeviceSize blockSize = 0);
+
+    // Frees all blocks; every allocation must have been freed by then
+    void Finalize();
+
+    VkResult Allocate(const VkMemoryRequirements &reqs,
+                      VkMemoryPropertyFlags props, ETriResourceKind kind,
+                      ETriAllocationStrategy strategy,
+                      TriAllocation &allocation);
+
+    void Free(TriAllocation &allocation);
+
+    // Allocate & bind in one go
+    VkResult AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags props,
+                               ETriAllocationStrategy strategy,
+                               TriAllocation &allocation);
+    VkResult AllocateForImage(VkImage image, VkMemoryPropertyFlags props,
+                              TriAllocation &allocation);
+
+    /* Compact free-list blocks by moving allocations towards the start of
+       their block through the hook; empty blocks are released afterwards.
+       Returns the number of allocations moved. The GPU must not be using
+       any of the moved resources, and the hook must not allocate.
+    */
+    uint32_t Defragment(const TriDefragMoveFn &move);
+
+    VkDevice GetDevice() const { return mDevice; }
+
+    const VkAllocationCallbacks *GetHostAllocator() const
+    {
+        return mHostAllocator;
+    }
+
+    uint32_t GetHeapCount() const { return mMemProps.memoryHeapCount; }
+
+    // Blocks are mBlockSize, capped to an eighth of the type's heap
+    VkDeviceSize BlockSizeFor(uint32_t memoryType) const;
+
+    TriMemoryHeapStats GetHeapStats(uint32_t heapIndex);
+
+    void LogStats();
+
+private:
+    bool AllocateFromBlock(TriMemoryBlock &block, VkDeviceSize size,
+                           VkDeviceSize alignment, ETriResourceKind kind,
+                           VkDeviceSize maxOffset, VkDeviceSize &offset);
+
+    void FreeInBlock(TriMemoryBlock &block, VkDeviceSize offset);
+
+    VkResult AllocateDedicated(const VkMemoryRequirements &reqs,
+                               TriAllocation &allocation);
+
+    // Host-visible blocks come back mapped; block is only set on success
+    VkResult CreateBlock(uint32_t memoryType, ETriAllocationStrategy strategy,
+                         TriMemoryBlock *&block);
+
+    // Unmaps & frees the block's memory; the caller drops it from mBlocks
+    void DestroyBlock(TriMemoryBlock &block);
+
+    void ReleaseEmptyBlocks(bool keepOne);
+
+    bool OnSamePage(VkDeviceSize lastByteOfA, VkDeviceSize firstByteOfB) const;
+
+private:
+    VkPhysicalDevice mPhysicalDevice;
+    VkDevice mDevice;
+    const VkAllocationCallbacks *mHostAllocator;
+    VkPhysicalDeviceMemoryProperties mMemProps;
+    VkDeviceSize mGranularity;
+    VkDeviceSize mBlockSize;
+
+    std::vector<std::unique_ptr<TriMemoryBlock>> mBlocks;
+
+    // Dedicated allocations per memory type
+    std::vector<uint64_t> mDedicatedCount;
+    std::vector<VkDeviceSize> mDedicatedBytes;
+
+    std::recursive_mutex mMutex;
+};
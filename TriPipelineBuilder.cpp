@@ -0,0 +1,429 @@
+#include "TriPipelineBuilder.hpp"
+#include "TriFrameStats.hpp"
+#include "TriLog.hpp"
+#include "TriShaderRegistry.hpp"
+
+#include <optional>
+
+void TriPipelineBuilder::Init(VkDevice device, VkPipelineCache pipelineCache,
+                              const VkAllocationCallbacks *hostAllocator,
+                              uint32_t threadCount)
+{
+    mDevice = device;
+    mPipelineCache = pipelineCache;
+    mHostAllocator = hostAllocator;
+    mCancelled.store(false, std::memory_order_relaxed);
+    mThreadPool.Init(threadCount);
+
+    TriLogVerbose() << "Pipeline builder running " << GetThreadCount()
+                    << " worker(s)";
+}
+
+void TriPipelineBuilder::Finalize()
+{
+    mThreadPool.Finalize();
+    mDevice = nullptr;
+    mPipelineCache = nullptr;
+    mHostAllocator = nullptr;
+}
+
+void TriPipelineBuilder::Cancel()
+{
+    mCancelled.store(true, std::memory_order_relaxed);
+}
+
+std::future<VkPipeline> TriPipelineBuilder::Build(const TriPipelineDesc &desc)
+{
+    VkDevice device = mDevice;
+    VkPipelineCache pipelineCache = mPipelineCache;
+    const VkAllocationCallbacks *hostAllocator = mHostAllocator;
+    std::atomic<bool> *cancelled = &mCancelled;
+
+    return mThreadPool.Submit(
+        [device, pipelineCache, hostAllocator, desc, cancelled]() -> VkPipeline
+        {
+            if (cancelled->load(std::memory_order_relaxed))
+                return nullptr;
+
+            return Compile(device, pipelineCache, hostAllocator, desc);
+        });
+}
+
+std::vector<std::future<VkPipeline>>
+TriPipelineBuilder::BuildBatch(const std::vector<TriPipelineDesc> &descs)
+{
+    std::vector<std::future<VkPipeline>> futures;
+    futures.reserve(descs.size());
+
+    for (const TriPipelineDesc &desc : descs)
+    {
+        futures.emplace_back(Build(desc));
+    }
+
+    return futures;
+}
+
+std::future<VkPipeline>
+TriPipelineBuilder::Rebuild(const TriPipelineDesc &desc,
+                            const std::vector<std::string> &changedShaders)
+{
+    VkDevice device = mDevice;
+    VkPipelineCache pipelineCache = mPipelineCache;
+    const VkAllocationCallbacks *hostAllocator = mHostAllocator;
+
+    std::atomic<bool> *cancelled = &mCancelled;
+
+    TriPipelineDesc reloadDesc = desc;
+    reloadDesc.allowEmbeddedShaders = false;
+
+    return mThreadPool.Submit(
+        [device, pipelineCache, hostAllocator, reloadDesc, changedShaders,
+         cancelled]() -> VkPipeline
+        {
+            if (cancelled->load(std::memory_order_relaxed))
+                return nullptr;
+
+            for (const std::string &shader : changedShaders)
+            {
+                if (!CompileShaderSource(shader))
+                    return nullptr;
+            }
+
+            return Compile(device, pipelineCache, hostAllocator, reloadDesc);
+        });
+}
+
+std::future<VkPipeline>
+TriPipelineBuilder::BuildCompute(const std::string &computeShader,
+                                 VkPipelineLayout layout)
+{
+    VkDevice device = mDevice;
+    VkPipelineCache pipelineCache = mPipelineCache;
+    const VkAllocationCallbacks *hostAllocator = mHostAllocator;
+    std::atomic<bool> *cancelled = &mCancelled;
+
+    return mThreadPool.Submit(
+        [device, pipelineCache, hostAllocator, computeShader, layout,
+         cancelled]() -> VkPipeline
+        {
+            if (cancelled->load(std::memory_order_relaxed))
+                return nullptr;
+
+            return CompileCompute(device, pipelineCache, hostAllocator,
+                                  computeShader, layout);
+        });
+}
+
+VkShaderModule TriPipelineBuilder::CreateShaderModule(
+    VkDevice device, const VkAllocationCallbacks *hostAllocator,
+    const std::string &name, bool allowEmbedded)
+{
+    std::optional<TriShaderCode> code = LoadShaderCode(name, allowEmbedded);
+
+    if (!code.has_value())
+        return nullptr;
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.codeSize = code->Size();
+    createInfo.pCode = code->Data();
+
+    VkShaderModule shaderModule = nullptr;
+    VkResult result = vkCreateShaderModule(device, &createInfo, hostAllocator,
+                                           &shaderModule);
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed during Vulkan shader module creation";
+        return nullptr;
+    }
+
+    return shaderModule;
+}
+
+VkPipeline
+TriPipelineBuilder::Compile(VkDevice device, VkPipelineCache pipelineCache,
+                            const VkAllocationCallbacks *hostAllocator,
+                            const TriPipelineDesc &desc)
+{
+    TriClock::time_point start = TriClock::now();
+
+    VkShaderModule vertexShader = CreateShaderModule(
+        device, hostAllocator, desc.vertexShader, desc.allowEmbeddedShaders);
+    VkShaderModule fragmentShader = CreateShaderModule(
+        device, hostAllocator, desc.fragmentShader, desc.allowEmbeddedShaders);
+
+    if (!vertexShader || !fragmentShader)
+    {
+        TriLogError() << "Failed to create vertex/fragment shader(s) for "
+                      << desc.name;
+
+        if (vertexShader)
+            vkDestroyShaderModule(device, vertexShader, hostAllocator);
+
+        if (fragmentShader)
+            vkDestroyShaderModule(device, fragmentShader, hostAllocator);
+
+        return nullptr;
+    }
+
+    // Specialization constants, split by the stage(s) they apply to
+    std::vector<VkSpecializationMapEntry> vertexEntries;
+    std::vector<VkSpecializationMapEntry> fragmentEntries;
+    std::vector<uint32_t> specData;
+
+    for (const TriSpecConstant &constant : desc.specConstants)
+    {
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constant.constantId;
+        entry.offset = specData.size() * sizeof(uint32_t);
+        entry.size = sizeof(uint32_t);
+        specData.emplace_back(constant.value);
+
+        if (constant.stages & VK_SHADER_STAGE_VERTEX_BIT)
+            vertexEntries.emplace_back(entry);
+
+        if (constant.stages & VK_SHADER_STAGE_FRAGMENT_BIT)
+            fragmentEntries.emplace_back(entry);
+    }
+
+    VkSpecializationInfo vertexSpecInfo{};
+    vertexSpecInfo.mapEntryCount = vertexEntries.size();
+    vertexSpecInfo.pMapEntries = vertexEntries.data();
+    vertexSpecInfo.dataSize = specData.size() * sizeof(uint32_t);
+    vertexSpecInfo.pData = specData.data();
+
+    VkSpecializationInfo fragmentSpecInfo = vertexSpecInfo;
+    fragmentSpecInfo.mapEntryCount = fragmentEntries.size();
+    fragmentSpecInfo.pMapEntries = fragmentEntries.data();
+
+    // Vertex shader create info
+    VkPipelineShaderStageCreateInfo vertexShaderCreateInfo{};
+    vertexShaderCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertexShaderCreateInfo.pNext = nullptr;
+    vertexShaderCreateInfo.module = vertexShader;
+    vertexShaderCreateInfo.pName = "main";
+    vertexShaderCreateInfo.pSpecializationInfo =
+        vertexEntries.empty() ? nullptr : &vertexSpecInfo;
+
+    // Fragment shader create info
+    VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo{};
+    fragmentShaderCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragmentShaderCreateInfo.pNext = nullptr;
+    fragmentShaderCreateInfo.module = fragmentShader;
+    fragmentShaderCreateInfo.pName = "main";
+    fragmentShaderCreateInfo.pSpecializationInfo =
+        fragmentEntries.empty() ? nullptr : &fragmentSpecInfo;
+
+    VkPipelineShaderStageCreateInfo stages[] = {vertexShaderCreateInfo,
+                                                fragmentShaderCreateInfo};
+
+    // Dynamic states
+    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                 VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+    dynamicStateCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.pNext = nullptr;
+    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+    // Pipeline vertex input state
+    VkPipelineVertexInputStateCreateInfo vertexCreateInfo{};
+    vertexCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexCreateInfo.pNext = nullptr;
+    vertexCreateInfo.vertexBindingDescriptionCount = desc.vertexBindings.size();
+    vertexCreateInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+    vertexCreateInfo.vertexAttributeDescriptionCount =
+        desc.vertexAttributes.size();
+    vertexCreateInfo.pVertexAttributeDescriptions =
+        desc.vertexAttributes.data();
+
+    // Input assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.pNext = nullptr;
+    inputAssembly.topology = desc.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport & scissor are dynamic
+    VkPipelineViewportStateCreateInfo viewportCreateInfo{};
+    viewportCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportCreateInfo.pNext = nullptr;
+    viewportCreateInfo.viewportCount = 1;
+    viewportCreateInfo.scissorCount = 1;
+
+    // Rasterizer
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.pNext = nullptr;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = desc.polygonMode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = desc.cullMode;
+    rasterizer.frontFace = desc.frontFace;
+    rasterizer.depthBiasEnable = VK_FALSE;
+    rasterizer.depthBiasConstantFactor = 0.0f;
+    rasterizer.depthBiasClamp = 0.0f;
+    rasterizer.depthBiasSlopeFactor = 0.0f;
+
+    // Multisampling: disabled for now
+    VkPipelineMultisampleStateCreateInfo multiSample{};
+    multiSample.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multiSample.pNext = nullptr;
+    multiSample.sampleShadingEnable = VK_FALSE;
+    multiSample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multiSample.minSampleShading = 1.0f;
+    multiSample.pSampleMask = nullptr;
+    multiSample.alphaToCoverageEnable = VK_FALSE;
+    multiSample.alphaToOneEnable = VK_FALSE;
+
+    // Color blending
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (desc.blendEnable)
+    {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor =
+            VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    else
+    {
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        // Basically same as above
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.pNext = nullptr;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.blendConstants[0] = 0.0f;
+    colorBlending.blendConstants[1] = 0.0f;
+    colorBlending.blendConstants[2] = 0.0f;
+    colorBlending.blendConstants[3] = 0.0f;
+
+    // Without a render pass the attachment formats are given up front
+    VkPipelineRenderingCreateInfo renderingCreateInfo{};
+    renderingCreateInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingCreateInfo.pNext = nullptr;
+    renderingCreateInfo.viewMask = 0;
+    renderingCreateInfo.colorAttachmentCount = desc.colorFormats.size();
+    renderingCreateInfo.pColorAttachmentFormats = desc.colorFormats.data();
+    renderingCreateInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = desc.renderPass ? nullptr : &renderingCreateInfo;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = stages;
+    pipelineCreateInfo.pVertexInputState = &vertexCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    pipelineCreateInfo.pViewportState = &viewportCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizer;
+    pipelineCreateInfo.pMultisampleState = &multiSample;
+    pipelineCreateInfo.pDepthStencilState = nullptr;
+    pipelineCreateInfo.pColorBlendState = &colorBlending;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = desc.layout;
+    pipelineCreateInfo.renderPass = desc.renderPass;
+    pipelineCreateInfo.subpass = desc.subpass;
+    pipelineCreateInfo.basePipelineHandle = nullptr;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = nullptr;
+    VkResult result =
+        vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo,
+                                  hostAllocator, &pipeline);
+
+    vkDestroyShaderModule(device, vertexShader, hostAllocator);
+    vkDestroyShaderModule(device, fragmentShader, hostAllocator);
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create VkGraphicsPipeline " << desc.name;
+        return nullptr;
+    }
+
+    TriLogVerbose() << "Compiled pipeline " << desc.name << " in "
+                    << TriElapsedMs(start) << " ms";
+
+    return pipeline;
+}
+
+VkPipeline TriPipelineBuilder::CompileCompute(
+    VkDevice device, VkPipelineCache pipelineCache,
+    const VkAllocationCallbacks *hostAllocator,
+    const std::string &computeShader, VkPipelineLayout layout)
+{
+    TriClock::time_point start = TriClock::now();
+
+    VkShaderModule shaderModule =
+        CreateShaderModule(device, hostAllocator, computeShader, true);
+
+    if (!shaderModule)
+    {
+        TriLogError() << "Failed to create compute shader " << computeShader;
+        return nullptr;
+    }
+
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = layout;
+    pipelineCreateInfo.basePipelineHandle = nullptr;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = nullptr;
+    VkResult result =
+        vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo,
+                                 hostAllocator, &pipeline);
+
+    vkDestroyShaderModule(device, shaderModule, hostAllocator);
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create compute pipeline " << computeShader;
+        return nullptr;
+    }
+
+    TriLogVerbose() << "Compiled compute pipeline " << computeShader << " in "
+                    << TriElapsedMs(start) << " ms";
+
+    return pipeline;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "TriPipelineDesc.hpp"
+#include "TriThreadPool.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+/* Compiles pipelines in parallel on a worker pool. All workers share one
+   VkPipelineCache, which Vulkan synchronizes internally. Each Build() returns
+   a future resolving to the pipeline, or nullptr if compilation failed; the
+   caller owns the resulting pipelines.
+*/
+
+class TriPipelineBuilder
+{
+public:
+    TriPipelineBuilder()
+        : mDevice(nullptr), mPipelineCache(nullptr), mHostAllocator(nullptr),
+          mThreadPool(), mCancelled(false)
+    {
+    }
+
+    ~TriPipelineBuilder() { Finalize(); }
+
+public:
+    /* 0 threads sizes the pool from the hardware concurrency. Pipelines are
+       created with hostAllocator, so they must be destroyed with it as well.
+    */
+    void Init(VkDevice device, VkPipelineCache pipelineCache,
+              const VkAllocationCallbacks *hostAllocator, uint32_t threadCount);
+
+    // Wait for pending builds and join the workers
+    void Finalize();
+
+    /* Builds that have not started yet resolve to nullptr without compiling;
+       those already compiling still finish. Lasts until the next Init()
+    */
+    void Cancel();
+
+    std::future<VkPipeline> Build(const TriPipelineDesc &desc);
+
+    std::vector<std::future<VkPipeline>>
+    BuildBatch(const std::vector<TriPipelineDesc> &descs);
+
+    /* Recompile the changed shader sources, then build the pipeline from the
+       fresh SPIR-V on disk. Resolves to nullptr if either step fails.
+    */
+    std::future<VkPipeline>
+    Rebuild(const TriPipelineDesc &desc,
+            const std::vector<std::string> &changedShaders);
+
+    // Compute pipelines have no state beyond the shader & layout
+    std::future<VkPipeline> BuildCompute(const std::string &computeShader,
+                                         VkPipelineLayout layout);
+
+    uint32_t GetThreadCount() const { return mThreadPool.GetThreadCount(); }
+
+    const VkAllocationCallbacks *GetHostAllocator() const
+    {
+        return mHostAllocator;
+    }
+
+private:
+    static VkPipeline Compile(VkDevice device, VkPipelineCache pipelineCache,
+                              const VkAllocationCallbacks *hostAllocator,
+                              const TriPipelineDesc &desc);
+
+    static VkPipeline CompileCompute(VkDevice device,
+                                     VkPipelineCache pipelineCache,
+                                     const VkAllocationCallbacks *hostAllocator,
+                                     const std::string &computeShader,
+                                     VkPipelineLayout layout);
+
+    static VkShaderModule
+    CreateShaderModule(VkDevice device,
+                       const VkAllocationCallbacks *hostAllocator,
+                       const std::string &name, bool allowEmbedded);
+
+private:
+    VkDevice mDevice;
+    VkPipelineCache mPipelineCache;
+    const VkAllocationCallbacks *mHostAllocator;
+    TriThreadPool mThreadPool;
+
+    // Read by the workers, which are joined before the builder goes away
+    std::atomic<bool> mCancelled;
+};
@@ -0,0 +1,189 @@
+#include "TriPipelineCache.hpp"
+#include "TriFileUtils.hpp"
+#include "TriLog.hpp"
+
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#define TRI_PIPELINE_CACHE_MAGIC 0x43495254 // "TRIC"
+#define TRI_PIPELINE_CACHE_VERSION 1
+
+// Prepended to the driver blob on disk
+struct TriPipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+
+VkResult TriPipelineCache::Init(VkPhysicalDevice physicalDevice,
+                                VkDevice device,
+                                const VkAllocationCallbacks *hostAllocator,
+                                const std::string &path)
+{
+    mDevice = device;
+    mHostAllocator = hostAllocator;
+    mPath = path;
+    mWarm = false;
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &mProps);
+
+    std::optional<TriMappedFile> blob;
+    if (!mPath.empty())
+    {
+        blob = MapFile(mPath);
+    }
+
+    const char *initialData = nullptr;
+    size_t initialSize = 0;
+
+    if (blob.has_value() && ValidateBlob(blob->Data(), blob->Size()))
+    {
+        initialData = blob->Data() + sizeof(TriPipelineCacheFileHeader);
+        initialSize = blob->Size() - sizeof(TriPipelineCacheFileHeader);
+        mWarm = true;
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.initialDataSize = initialSize;
+    createInfo.pInitialData = initialData;
+
+    VkResult result = vkCreatePipelineCache(mDevice, &createInfo,
+                                            mHostAllocator, &mPipelineCache);
+
+    if (result != VK_SUCCESS && mWarm)
+    {
+        // The driver may still reject a blob that passed our checks
+        TriLogWarning() << "Driver rejected pipeline cache " << mPath
+                        << ", starting cold";
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        mWarm = false;
+
+        result = vkCreatePipelineCache(mDevice, &createInfo, mHostAllocator,
+                                       &mPipelineCache);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create pipeline cache: " << result;
+        mPipelineCache = nullptr;
+        return result;
+    }
+
+    TriLogInfo() << "Pipeline cache created (" << (mWarm ? "warm" : "cold")
+                 << ", " << initialSize << " bytes)";
+
+    return VK_SUCCESS;
+}
+
+void TriPipelineCache::Finalize()
+{
+    if (!mPipelineCache)
+        return;
+
+    if (!mPath.empty())
+    {
+        size_t dataSize = 0;
+        vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr);
+
+        std::vector<char> file(sizeof(TriPipelineCacheFileHeader) + dataSize);
+        VkResult result = vkGetPipelineCacheData(
+            mDevice, mPipelineCache, &dataSize,
+            file.data() + sizeof(TriPipelineCacheFileHeader));
+
+        if (result == VK_SUCCESS)
+        {
+            TriPipelineCacheFileHeader header{};
+            header.magic = TRI_PIPELINE_CACHE_MAGIC;
+            header.version = TRI_PIPELINE_CACHE_VERSION;
+            header.vendorID = mProps.vendorID;
+            header.deviceID = mProps.deviceID;
+            header.driverVersion = mProps.driverVersion;
+            std::memcpy(header.pipelineCacheUUID, mProps.pipelineCacheUUID,
+                        VK_UUID_SIZE);
+            header.dataSize = dataSize;
+            std::memcpy(file.data(), &header, sizeof(header));
+
+            file.resize(sizeof(TriPipelineCacheFileHeader) + dataSize);
+
+            if (WriteBinaryFileAtomic(mPath, file.data(), file.size()))
+            {
+                TriLogInfo() << "Pipeline cache saved to " << mPath << " ("
+                             << dataSize << " bytes)";
+            }
+        }
+        else
+        {
+            TriLogWarning() << "Failed to retrieve pipeline cache data: "
+                            << result;
+        }
+    }
+
+    vkDestroyPipelineCache(mDevice, mPipelineCache, mHostAllocator);
+    mPipelineCache = nullptr;
+    mDevice = nullptr;
+    mHostAllocator = nullptr;
+    mWarm = false;
+}
+
+bool TriPipelineCache::ValidateBlob(const char *data, size_t size)
+{
+    if (size < sizeof(TriPipelineCacheFileHeader))
+    {
+        TriLogWarning() << "Pipeline cache " << mPath << " is truncated";
+        return false;
+    }
+
+    TriPipelineCacheFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.magic != TRI_PIPELINE_CACHE_MAGIC ||
+        header.version != TRI_PIPELINE_CACHE_VERSION ||
+        header.dataSize != size - sizeof(header))
+    {
+        TriLogWarning() << "Pipeline cache " << mPath << " is malformed";
+        return false;
+    }
+
+    if (header.vendorID != mProps.vendorID ||
+        header.deviceID != mProps.deviceID ||
+        header.driverVersion != mProps.driverVersion ||
+        std::memcmp(header.pipelineCacheUUID, mProps.pipelineCacheUUID,
+                    VK_UUID_SIZE) != 0)
+    {
+        TriLogInfo() << "Pipeline cache " << mPath
+                     << " belongs to another device/driver, discarding";
+        return false;
+    }
+
+    // The driver's own header must agree as well
+    VkPipelineCacheHeaderVersionOne driverHeader;
+    if (header.dataSize < sizeof(driverHeader))
+    {
+        TriLogWarning() << "Pipeline cache " << mPath << " has no driver data";
+        return false;
+    }
+
+    std::memcpy(&driverHeader, data + sizeof(header), sizeof(driverHeader));
+
+    if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        driverHeader.vendorID != mProps.vendorID ||
+        driverHeader.deviceID != mProps.deviceID ||
+        std::memcmp(driverHeader.pipelineCacheUUID, mProps.pipelineCacheUUID,
+                    VK_UUID_SIZE) != 0)
+    {
+        TriLogWarning() << "Pipeline cache " << mPath
+                        << " has a mismatching driver header";
+        return false;
+    }
+
+    return true;
+}
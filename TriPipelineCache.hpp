@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+/* VkPipelineCache that persists across runs. The driver blob is stored behind
+   a small header of our own; a blob written by a different device or driver
+   version is discarded instead of being handed to the driver.
+*/
+
+class TriPipelineCache
+{
+public:
+    TriPipelineCache()
+        : mDevice(nullptr), mHostAllocator(nullptr), mPipelineCache(nullptr),
+          mPath(), mProps(), mWarm(false)
+    {
+    }
+
+    ~TriPipelineCache() { Finalize(); }
+
+public:
+    // An empty path gives a cache that lives only as long as this object
+    VkResult Init(VkPhysicalDevice physicalDevice, VkDevice device,
+                  const VkAllocationCallbacks *hostAllocator,
+                  const std::string &path);
+
+    // Write the cache back to disk (if Init() had a path) and destroy it
+    void Finalize();
+
+    VkPipelineCache Get() const { return mPipelineCache; }
+
+    // Whether Init() found a valid blob on disk
+    bool IsWarm() const { return mWarm; }
+
+private:
+    bool ValidateBlob(const char *data, size_t size);
+
+private:
+    VkDevice mDevice;
+    const VkAllocationCallbacks *mHostAllocator;
+    VkPipelineCache mPipelineCache;
+    std::string mPath;
+    VkPhysicalDeviceProperties mProps;
+    bool mWarm;
+};
@@ -0,0 +1,104 @@
+#include "TriPipelineDesc.hpp"
+
+// FNV-1a; the descriptions are tiny, so anything fancier is wasted
+
+static void HashBytes(uint64_t &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+template <typename T> static void HashValue(uint64_t &hash, const T &value)
+{
+    HashBytes(hash, &value, sizeof(value));
+}
+
+static void HashString(uint64_t &hash, const std::string &value)
+{
+    HashValue(hash, value.size());
+    HashBytes(hash, value.data(), value.size());
+}
+
+static bool operator==(const VkVertexInputBindingDescription &a,
+                       const VkVertexInputBindingDescription &b)
+{
+    return a.binding == b.binding && a.stride == b.stride &&
+           a.inputRate == b.inputRate;
+}
+
+static bool operator==(const VkVertexInputAttributeDescription &a,
+                       const VkVertexInputAttributeDescription &b)
+{
+    return a.location == b.location && a.binding == b.binding &&
+           a.format == b.format && a.offset == b.offset;
+}
+
+bool TriPipelineDesc::operator==(const TriPipelineDesc &other) const
+{
+    return vertexShader == other.vertexShader &&
+           fragmentShader == other.fragmentShader &&
+           allowEmbeddedShaders == other.allowEmbeddedShaders &&
+           layout == other.layout && renderPass == other.renderPass &&
+           subpass == other.subpass && colorFormats == other.colorFormats &&
+           vertexBindings == other.vertexBindings &&
+           vertexAttributes == other.vertexAttributes &&
+           topology == other.topology &&
+           polygonMode == other.polygonMode && cullMode == other.cullMode &&
+           frontFace == other.frontFace && blendEnable == other.blendEnable &&
+           specConstants == other.specConstants;
+}
+
+size_t TriPipelineDescHash::operator()(const TriPipelineDesc &desc) const
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    HashString(hash, desc.vertexShader);
+    HashString(hash, desc.fragmentShader);
+    HashValue(hash, desc.allowEmbeddedShaders);
+    HashValue(hash, desc.layout);
+    HashValue(hash, desc.renderPass);
+    HashValue(hash, desc.subpass);
+
+    HashValue(hash, desc.colorFormats.size());
+    for (VkFormat format : desc.colorFormats)
+        HashValue(hash, format);
+
+    HashValue(hash, desc.vertexBindings.size());
+    for (const VkVertexInputBindingDescription &binding : desc.vertexBindings)
+    {
+        HashValue(hash, binding.binding);
+        HashValue(hash, binding.stride);
+        HashValue(hash, binding.inputRate);
+    }
+
+    HashValue(hash, desc.vertexAttributes.size());
+    for (const VkVertexInputAttributeDescription &attribute :
+         desc.vertexAttributes)
+    {
+        HashValue(hash, attribute.location);
+        HashValue(hash, attribute.binding);
+        HashValue(hash, attribute.format);
+        HashValue(hash, attribute.offset);
+    }
+
+    HashValue(hash, desc.topology);
+    HashValue(hash, desc.polygonMode);
+    HashValue(hash, desc.cullMode);
+    HashValue(hash, desc.frontFace);
+    HashValue(hash, desc.blendEnable);
+
+    HashValue(hash, desc.specConstants.size());
+    for (const TriSpecConstant &constant : desc.specConstants)
+    {
+        HashValue(hash, constant.stages);
+        HashValue(hash, constant.constantId);
+        HashValue(hash, constant.value);
+    }
+
+    return static_cast<size_t>(hash);
+}
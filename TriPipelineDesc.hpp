@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A 32-bit specialization constant (bool, int or float bit pattern)
+
+struct TriSpecConstant
+{
+    VkShaderStageFlags stages;
+    uint32_t constantId;
+    uint32_t value;
+
+    bool operator==(const TriSpecConstant &other) const
+    {
+        return stages == other.stages && constantId == other.constantId &&
+               value == other.value;
+    }
+};
+
+/* Everything needed to compile one graphics pipeline off the main thread.
+   Two descriptions that compare equal produce the same pipeline, which is
+   what TriPipelineVariantCache dedupes on; the name is only a label and
+   takes no part in that.
+*/
+
+struct TriPipelineDesc
+{
+    std::string name;
+
+    // Shader names as known to the registry, e.g. "triangle.vert"
+    std::string vertexShader;
+    std::string fragmentShader;
+
+    // Cleared for hot reloads, where only the file on disk is up to date
+    bool allowEmbeddedShaders = true;
+
+    VkPipelineLayout layout = nullptr;
+    VkRenderPass renderPass = nullptr;
+    uint32_t subpass = 0;
+
+    // Attachment formats for dynamic rendering, used when renderPass is null
+    std::vector<VkFormat> colorFormats;
+
+    // Vertex buffer layout; empty for shaders that generate their vertices
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    // Standard "over" alpha blending on the color attachment
+    bool blendEnable = false;
+
+    std::vector<TriSpecConstant> specConstants;
+
+    bool operator==(const TriPipelineDesc &other) const;
+    bool operator!=(const TriPipelineDesc &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+struct TriPipelineDescHash
+{
+    size_t operator()(const TriPipelineDesc &desc) const;
+};
@@ -0,0 +1,106 @@
+#include "TriPipelineVariantCache.hpp"
+#include "TriLog.hpp"
+
+#include <chrono>
+
+void TriPipelineVariantCache::Init(VkDevice device,
+                                   TriPipelineBuilder *builder)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mDevice = device;
+    mBuilder = builder;
+}
+
+void TriPipelineVariantCache::Finalize()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto &variant : mVariants)
+    {
+        VkPipeline pipeline = variant.second.get();
+
+        if (pipeline)
+            vkDestroyPipeline(mDevice, pipeline, mBuilder->GetHostAllocator());
+    }
+
+    if (!mVariants.empty())
+    {
+        TriLogVerbose() << "Pipeline variants: " << mVariants.size()
+                        << " compiled, " << mHits << " deduped request(s)";
+    }
+
+    mVariants.clear();
+    mDevice = nullptr;
+    mBuilder = nullptr;
+    mHits = 0;
+    mMisses = 0;
+}
+
+std::shared_future<VkPipeline>
+TriPipelineVariantCache::Request(const TriPipelineDesc &desc)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mVariants.find(desc);
+
+    if (it != mVariants.end())
+    {
+        // A compile that finished without a pipeline (e.g. a shader that did
+        // not build) is retried rather than handed out forever
+        bool failed = it->second.wait_for(std::chrono::seconds(0)) ==
+                          std::future_status::ready &&
+                      it->second.get() == nullptr;
+
+        if (!failed)
+        {
+            mHits++;
+            return it->second;
+        }
+
+        mVariants.erase(it);
+    }
+
+    mMisses++;
+
+    std::shared_future<VkPipeline> future = mBuilder->Build(desc).share();
+    mVariants.emplace(desc, future);
+
+    return future;
+}
+
+uint64_t TriPipelineVariantCache::GetHits() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+uint64_t TriPipelineVariantCache::GetMisses() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMisses;
+}
+
+VkPipeline TriPipelineVariantCache::Replace(const TriPipelineDesc &desc,
+                                            VkPipeline pipeline)
+{
+    std::promise<VkPipeline> promise;
+    promise.set_value(pipeline);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    VkPipeline previous = nullptr;
+    auto it = mVariants.find(desc);
+
+    if (it != mVariants.end())
+    {
+        previous = it->second.get();
+        it->second = promise.get_future().share();
+    }
+    else
+    {
+        mVariants.emplace(desc, promise.get_future().share());
+    }
+
+    return previous;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "TriPipelineBuilder.hpp"
+#include "TriPipelineDesc.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+/* Dedupes pipeline requests: the first request for a description queues a
+   compile on the builder, later identical requests (including those made
+   while it is still compiling) share its future. A failed compile is not
+   kept: the next request for it compiles again. The cache owns every
+   pipeline it hands out and destroys them in Finalize(). Thread-safe.
+*/
+
+class TriPipelineVariantCache
+{
+public:
+    TriPipelineVariantCache()
+        : mDevice(nullptr), mBuilder(nullptr), mVariants(), mMutex(),
+          mHits(0), mMisses(0)
+    {
+    }
+
+    ~TriPipelineVariantCache() { Finalize(); }
+
+public:
+    void Init(VkDevice device, TriPipelineBuilder *builder);
+
+    // Waits for pending compiles, then destroys all cached pipelines
+    void Finalize();
+
+    std::shared_future<VkPipeline> Request(const TriPipelineDesc &desc);
+
+    /* Point desc at a pipeline built elsewhere (e.g. by a hot reload). Returns
+       the pipeline it replaces, which the caller must destroy once no frame
+       in flight uses it anymore.
+    */
+    VkPipeline Replace(const TriPipelineDesc &desc, VkPipeline pipeline);
+
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+private:
+    VkDevice mDevice;
+    TriPipelineBuilder *mBuilder;
+
+    std::unordered_map<TriPipelineDesc, std::shared_future<VkPipeline>,
+                       TriPipelineDescHash>
+        mVariants;
+    mutable std::mutex mMutex;
+
+    uint64_t mHits;
+    uint64_t mMisses;
+};
@@ -0,0 +1,407 @@
+#include "TriSettings.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
+const char *TriPresentModeName(ETriPresentMode mode)
+{
+    switch (mode)
+    {
+    case TriPresentFifo:
+        return "fifo";
+
+    case TriPresentFifoRelaxed:
+        return "fifo-relaxed";
+
+    case TriPresentMailbox:
+        return "mailbox";
+
+    case TriPresentImmediate:
+        return "immediate";
+    }
+
+    return "unknown";
+}
+
+const char *TriDevicePolicyName(ETriDevicePolicy policy)
+{
+    switch (policy)
+    {
+    case TriDeviceDiscreteFirst:
+        return "discrete";
+
+    case TriDeviceByMemory:
+        return "memory";
+
+    case TriDeviceByQueues:
+        return "queues";
+
+    case TriDeviceByUUID:
+        return "uuid";
+    }
+
+    return "unknown";
+}
+
+const char *TriHostAllocatorName(ETriHostAllocator mode)
+{
+    switch (mode)
+    {
+    case TriHostAllocDriver:
+        return "driver";
+
+    case TriHostAllocSystem:
+        return "system";
+
+    case TriHostAllocPooled:
+        return "pooled";
+    }
+
+    return "unknown";
+}
+
+// Base 10
+bool ParseInteger(const char *text, long long &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtoll(text, &end, 10);
+
+    if (end == text || *end != '\0' || errno == ERANGE)
+    {
+        TriLogError() << "Not a valid integer: " << text;
+        return false;
+    }
+
+    return true;
+}
+
+bool ParseFloat(const char *text, float &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtof(text, &end);
+
+    if (end == text || *end != '\0' || errno == ERANGE)
+    {
+        TriLogError() << "Not a valid number: " << text;
+        return false;
+    }
+
+    return true;
+}
+
+static void PrintUsage(const char *program)
+{
+    TriLogInfo() << "Usage: " << program << " [options]";
+    TriLogInfo() << "  --frames-in-flight <1-" << TRI_MAX_FRAMES_IN_FLIGHT
+                 << ">  Frames recorded ahead of the GPU (default "
+                 << TRI_DEFAULT_FRAMES_IN_FLIGHT << ")";
+    TriLogInfo() << "  --present-mode <fifo|fifo-relaxed|mailbox|immediate>"
+                    "  Present mode policy (default fifo)";
+    TriLogInfo() << "  --headless  Render offscreen without a window";
+    TriLogInfo() << "  --frames <n>  Exit after n frames (default: unlimited)";
+    TriLogInfo() << "  --pipeline-cache <path>  Pipeline cache file, empty "
+                    "disables (default tri_pipeline_cache.bin)";
+    TriLogInfo() << "  --pipeline-threads <0-" << TRI_MAX_PIPELINE_THREADS
+                 << ">  Pipeline compiler threads (default 0: CPU count - 1)";
+    TriLogInfo() << "  --hot-reload  Rebuild pipelines when shaders change";
+    TriLogInfo() << "  --instances <1-" << TRI_MAX_INSTANCES
+                 << ">  Instances drawn per frame (default 1)";
+    TriLogInfo() << "  --static-instances  Do not stream instance data";
+    TriLogInfo() << "  --gpu-culling  Cull instances on the GPU, draw "
+                    "indirectly";
+    TriLogInfo() << "  --scene-extent <scale>  Spread the instances over "
+                    "scale times the viewport (default 1)";
+    TriLogInfo() << "  --single-queue  Upload & cull on the graphics queue";
+    TriLogInfo() << "  --no-dynamic-rendering  Always use render passes & "
+                    "framebuffers";
+    TriLogInfo() << "  --device-policy <discrete|memory|queues>  How the GPU "
+                    "is picked (default discrete)";
+    TriLogInfo() << "  --device-uuid <uuid>  Use the GPU with this "
+                    "deviceUUID";
+    TriLogInfo() << "  --device-cache <path>  Device choice cache, empty "
+                    "disables (default tri_device_cache.txt)";
+    TriLogInfo() << "  --host-allocator <driver|system|pooled>  Driver host "
+                    "memory (default pooled)";
+    TriLogInfo() << "  --no-gpu-profiling  Skip GPU timestamp & statistics "
+                    "queries";
+    TriLogInfo() << "  --cpu-trace <path>  Chrome trace of CPU scopes "
+                    "(default tri_cpu_trace.json)";
+    TriLogInfo() << "  --cpu-trace-frames <n>  Trace the first n frames; F12 "
+                    "toggles tracing";
+    TriLogInfo() << "  --log-file <path>  Log to a file instead of the console";
+    TriLogInfo() << "  --log-overflow <drop|block>  When the log queue is "
+                    "full (default drop; warnings & errors always wait)";
+    TriLogInfo() << "  --sync-log  Write log lines on the logging thread";
+}
+
+bool ParseSettings(int argc, char **argv, TriSettings &settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--frames-in-flight" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return false;
+
+            if (value < 1 || value > TRI_MAX_FRAMES_IN_FLIGHT)
+            {
+                TriLogError() << "Frames in flight must be within [1, "
+                              << TRI_MAX_FRAMES_IN_FLIGHT << "]";
+                return false;
+            }
+
+            settings.framesInFlight = static_cast<uint32_t>(value);
+        }
+        else if (arg == "--present-mode" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            bool found = false;
+
+            for (ETriPresentMode mode :
+                 {TriPresentFifo, TriPresentFifoRelaxed, TriPresentMailbox,
+                  TriPresentImmediate})
+            {
+                if (value == TriPresentModeName(mode))
+                {
+                    settings.presentMode = mode;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                TriLogError() << "Unknown present mode: " << value;
+                PrintUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (arg == "--headless")
+        {
+            settings.headless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return false;
+
+            if (value < 0)
+            {
+                TriLogError() << "Frame count must not be negative";
+                return false;
+            }
+
+            settings.maxFrames = static_cast<uint64_t>(value);
+        }
+        else if (arg == "--pipeline-cache" && i + 1 < argc)
+        {
+            settings.pipelineCachePath = argv[++i];
+        }
+        else if (arg == "--pipeline-threads" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return false;
+
+            if (value < 0 || value > TRI_MAX_PIPELINE_THREADS)
+            {
+                TriLogError() << "Pipeline thread count must be within [0, "
+                              << TRI_MAX_PIPELINE_THREADS << "]";
+                return false;
+            }
+
+            settings.pipelineThreads = static_cast<uint32_t>(value);
+        }
+        else if (arg == "--hot-reload")
+        {
+            settings.hotReload = true;
+        }
+        else if (arg == "--instances" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return false;
+
+            if (value < 1 || value > TRI_MAX_INSTANCES)
+            {
+                TriLogError() << "Instance count must be within [1, "
+                              << TRI_MAX_INSTANCES << "]";
+                return false;
+            }
+
+            settings.instances = static_cast<uint64_t>(value);
+        }
+        else if (arg == "--static-instances")
+        {
+            settings.staticInstances = true;
+        }
+        else if (arg == "--scene-extent" && i + 1 < argc)
+        {
+            float value = 0.0f;
+            if (!ParseFloat(argv[++i], value))
+                return false;
+
+            if (!(value > 0.0f && value <= 1000.0f))
+            {
+                TriLogError() << "Scene extent must be within (0, 1000]";
+                return false;
+            }
+
+            settings.sceneExtent = value;
+        }
+        else if (arg == "--gpu-culling")
+        {
+            settings.gpuCulling = true;
+        }
+        else if (arg == "--single-queue")
+        {
+            settings.asyncQueues = false;
+        }
+        else if (arg == "--no-dynamic-rendering")
+        {
+            settings.dynamicRendering = false;
+        }
+        else if (arg == "--device-policy" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            bool found = false;
+
+            for (ETriDevicePolicy policy :
+                 {TriDeviceDiscreteFirst, TriDeviceByMemory, TriDeviceByQueues})
+            {
+                if (value == TriDevicePolicyName(policy))
+                {
+                    settings.devicePolicy = policy;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                TriLogError() << "Unknown device policy: " << value;
+                PrintUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (arg == "--device-uuid" && i + 1 < argc)
+        {
+            // Accept the dashed form vulkaninfo prints as well
+            std::string value = argv[++i];
+            value.erase(std::remove(value.begin(), value.end(), '-'),
+                        value.end());
+            std::transform(value.begin(), value.end(), value.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+
+            if (value.size() != 32 ||
+                value.find_first_not_of("0123456789abcdef") !=
+                    std::string::npos)
+            {
+                TriLogError() << "Device UUID must be 16 hex bytes";
+                return false;
+            }
+
+            settings.deviceUUID = value;
+            settings.devicePolicy = TriDeviceByUUID;
+        }
+        else if (arg == "--device-cache" && i + 1 < argc)
+        {
+            settings.deviceCachePath = argv[++i];
+        }
+        else if (arg == "--host-allocator" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            bool found = false;
+
+            for (ETriHostAllocator mode :
+                 {TriHostAllocDriver, TriHostAllocSystem, TriHostAllocPooled})
+            {
+                if (value == TriHostAllocatorName(mode))
+                {
+                    settings.hostAllocator = mode;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                TriLogError() << "Unknown host allocator: " << value;
+                PrintUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (arg == "--no-gpu-profiling")
+        {
+            settings.gpuProfiling = false;
+        }
+        else if (arg == "--cpu-trace" && i + 1 < argc)
+        {
+            settings.cpuTracePath = argv[++i];
+        }
+        else if (arg == "--cpu-trace-frames" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return false;
+
+            if (value < 0)
+            {
+                TriLogError() << "Trace frame count must not be negative";
+                return false;
+            }
+
+            settings.cpuTraceFrames = static_cast<uint64_t>(value);
+        }
+        else if (arg == "--log-file" && i + 1 < argc)
+        {
+            settings.log.path = argv[++i];
+        }
+        else if (arg == "--log-overflow" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+
+            if (value == "drop")
+            {
+                settings.log.overflow = TriLogDrop;
+            }
+            else if (value == "block")
+            {
+                settings.log.overflow = TriLogBlock;
+            }
+            else
+            {
+                TriLogError() << "Unknown log overflow policy: " << value;
+                PrintUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (arg == "--sync-log")
+        {
+            settings.log.async = false;
+        }
+        else if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        else
+        {
+            TriLogError() << "Unknown argument: " << arg;
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
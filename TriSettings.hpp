@@ -0,0 +1,123 @@
+#pragma once
+
+#include "TriConfig.hpp"
+#include "TriLog.hpp"
+
+#include <cstdint>
+#include <string>
+
+#define TRI_MAX_FRAMES_IN_FLIGHT 8
+#define TRI_MAX_INSTANCES 16000000
+#define TRI_MAX_PIPELINE_THREADS 256
+
+// Present mode policies; anything unavailable falls back to FIFO
+
+enum ETriPresentMode
+{
+    TriPresentFifo,        // Strict v-sync, always available
+    TriPresentFifoRelaxed, // V-sync, but late frames tear instead of waiting
+    TriPresentMailbox,     // Low latency, newest frame replaces queued one
+    TriPresentImmediate    // Uncapped, tears
+};
+
+const char *TriPresentModeName(ETriPresentMode mode);
+
+// How the physical device is picked among the suitable ones
+
+enum ETriDevicePolicy
+{
+    TriDeviceDiscreteFirst, // Discrete > integrated > virtual > CPU
+    TriDeviceByMemory,      // Largest device-local heap
+    TriDeviceByQueues,      // Most async compute & transfer queue families
+    TriDeviceByUUID         // TriSettings::deviceUUID
+};
+
+const char *TriDevicePolicyName(ETriDevicePolicy policy);
+
+// Where the driver's host memory comes from
+
+enum ETriHostAllocator
+{
+    TriHostAllocDriver, // No callbacks; the driver's own heap, no statistics
+    TriHostAllocSystem, // malloc & free, with statistics
+    TriHostAllocPooled  // Size-class pools per allocation scope
+};
+
+const char *TriHostAllocatorName(ETriHostAllocator mode);
+
+// Startup settings for TriApp; populated from the command line in main()
+
+struct TriSettings
+{
+    // How many frames the CPU may record ahead of the GPU
+    uint32_t framesInFlight = TRI_DEFAULT_FRAMES_IN_FLIGHT;
+
+    ETriPresentMode presentMode = TriPresentFifo;
+
+    // Render into offscreen images instead of a GLFW window & swap chain
+    bool headless = false;
+
+    // Stop Loop() after this many frames; 0 runs until the window closes
+    uint64_t maxFrames = 0;
+
+    // Where the pipeline cache persists between runs; empty disables it
+    std::string pipelineCachePath = "tri_pipeline_cache.bin";
+
+    // Pipeline compiler threads; 0 sizes the pool from the CPU count
+    uint32_t pipelineThreads = 0;
+
+    // Watch the shader sources and rebuild pipelines when they change
+    bool hotReload = false;
+
+    // Instances of the mesh drawn per frame (stress scene when > 1)
+    uint64_t instances = 1;
+
+    // Write instance data once instead of streaming it every frame
+    bool staticInstances = false;
+
+    // Cull instances in a compute pass & draw the survivors indirectly
+    bool gpuCulling = false;
+
+    // The instance grid spans this many times the viewport; > 1 puts the
+    // outer instances off-screen for culling to reject
+    float sceneExtent = 1.0f;
+
+    // Use dedicated transfer & async compute queues when the device has them
+    bool asyncQueues = true;
+
+    // Render without VkRenderPass/VkFramebuffer when the device supports it
+    bool dynamicRendering = true;
+
+    ETriDevicePolicy devicePolicy = TriDeviceDiscreteFirst;
+
+    // Lowercase hex without dashes; used by TriDeviceByUUID
+    std::string deviceUUID;
+
+    // Where the chosen device persists between runs; empty disables it
+    std::string deviceCachePath = "tri_device_cache.txt";
+
+    ETriHostAllocator hostAllocator = TriHostAllocPooled;
+
+    // Time the GPU side of each frame with timestamp & statistics queries
+    bool gpuProfiling = true;
+
+    // CPU scope trace (see TriCpuProfiler.hpp), written when a capture ends
+    std::string cpuTracePath = "tri_cpu_trace.json";
+
+    // Capture the first n frames; F12 starts & stops a capture any time
+    uint64_t cpuTraceFrames = 0;
+
+    // Handed to TriLogStart() once the arguments are parsed
+    TriLogOptions log;
+};
+
+/* Whole-string numbers: trailing garbage, an empty string or an out-of-range
+   value fail (and are logged) rather than quietly parsing as 0
+*/
+bool ParseInteger(const char *text, long long &value);
+bool ParseFloat(const char *text, float &value);
+
+/* Parse command line arguments into settings. Returns false (after printing
+   usage) if the arguments are malformed.
+*/
+bool ParseSettings(int argc, char **argv, TriSettings &settings);
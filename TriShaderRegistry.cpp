@@ -0,0 +1,134 @@
+#include "TriShaderRegistry.hpp"
+#include "TriFileUtils.hpp"
+#include "TriLog.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+// Preloaded shaders, each handed out once by LoadShaderCode()
+static std::mutex gPreloadedMutex;
+static std::unordered_map<std::string, TriShaderCode> gPreloadedShaders;
+
+static std::optional<TriShaderCode> TakePreloadedShader(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(gPreloadedMutex);
+
+    auto position = gPreloadedShaders.find(name);
+    if (position == gPreloadedShaders.end())
+        return std::nullopt;
+
+    TriShaderCode code = std::move(position->second);
+    gPreloadedShaders.erase(position);
+
+    return code;
+}
+
+const TriEmbeddedShader *FindEmbeddedShader(const std::string &name)
+{
+#if TRI_EMBED_SHADERS
+    for (size_t i = 0; i < gTriEmbeddedShaderCount; i++)
+    {
+        if (std::strcmp(gTriEmbeddedShaders[i].name, name.c_str()) == 0)
+            return &gTriEmbeddedShaders[i];
+    }
+#else
+    (void)name;
+#endif
+
+    return nullptr;
+}
+
+std::optional<TriShaderCode> LoadShaderCode(const std::string &name,
+                                            bool allowEmbedded)
+{
+    const TriEmbeddedShader *embedded =
+        allowEmbedded ? FindEmbeddedShader(name) : nullptr;
+
+    if (embedded)
+        return TriShaderCode(*embedded);
+
+    // Hot reloads (allowEmbedded == false) always want the file as it is now
+    if (allowEmbedded)
+    {
+        std::optional<TriShaderCode> preloaded = TakePreloadedShader(name);
+        if (preloaded.has_value())
+            return preloaded;
+    }
+
+    std::string path = "Shaders/" + name + ".svc";
+    std::optional<TriMappedFile> file = MapFile(path);
+
+    if (!file.has_value())
+    {
+        TriLogError() << "Shader " << name << " is neither embedded nor at "
+                      << path;
+        return std::nullopt;
+    }
+
+    if (file->Size() == 0 || file->Size() % sizeof(uint32_t) != 0)
+    {
+        TriLogError() << path << " is not valid SPIR-V";
+        return std::nullopt;
+    }
+
+    return TriShaderCode(std::move(*file));
+}
+
+void PreloadShaderCode(const std::vector<std::string> &names)
+{
+    for (const std::string &name : names)
+    {
+        if (FindEmbeddedShader(name))
+            continue;
+
+        std::optional<TriShaderCode> code = LoadShaderCode(name, false);
+        if (!code.has_value())
+            continue;
+
+        // Fault every page in now, rather than in vkCreateShaderModule()
+        const unsigned char *bytes =
+            reinterpret_cast<const unsigned char *>(code->Data());
+        volatile unsigned char sink = 0;
+        for (size_t offset = 0; offset < code->Size(); offset += 4096)
+            sink = sink + bytes[offset];
+
+        std::lock_guard<std::mutex> lock(gPreloadedMutex);
+        gPreloadedShaders.emplace(name, std::move(*code));
+    }
+}
+
+void ClearPreloadedShaderCode()
+{
+    std::lock_guard<std::mutex> lock(gPreloadedMutex);
+    gPreloadedShaders.clear();
+}
+
+bool CompileShaderSource(const std::string &name)
+{
+    std::string source = std::string(TRI_SHADER_SOURCE_DIR) + "/" + name;
+    std::string output = "Shaders/" + name + ".svc";
+    std::string tmpOutput = output + ".tmp";
+
+    std::string command = std::string("\"") + TRI_GLSLC + "\" \"" + source +
+                          "\" -o \"" + tmpOutput + "\"";
+
+    if (std::system(command.c_str()) != 0)
+    {
+        TriLogError() << "glslc failed for " << source;
+        std::remove(tmpOutput.c_str());
+        return false;
+    }
+
+    // The pipeline rebuild maps the file, so never expose a partial one
+    if (std::rename(tmpOutput.c_str(), output.c_str()) != 0)
+    {
+        TriLogError() << "Failed to replace " << output;
+        std::remove(tmpOutput.c_str());
+        return false;
+    }
+
+    return true;
+}
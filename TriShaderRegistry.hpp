@@ -0,0 +1,87 @@
+#pragma once
+
+#include "TriConfig.hpp"
+#include "TriFileUtils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// One SPIR-V module compiled into the executable (-Dembed_shaders=true)
+
+struct TriEmbeddedShader
+{
+    const char *name;
+    const uint32_t *code;
+    size_t size; // In bytes
+};
+
+#if TRI_EMBED_SHADERS
+// Generated by meson from TriEmbeddedShaders.cpp.in
+extern const TriEmbeddedShader gTriEmbeddedShaders[];
+extern const size_t gTriEmbeddedShaderCount;
+#endif
+
+/* SPIR-V code of a shader, pointing either into the executable or into a
+   mapping of the file on disk
+*/
+
+class TriShaderCode
+{
+public:
+    explicit TriShaderCode(const TriEmbeddedShader &shader)
+        : mEmbeddedCode(shader.code), mEmbeddedSize(shader.size), mFile()
+    {
+    }
+
+    explicit TriShaderCode(TriMappedFile &&file)
+        : mEmbeddedCode(nullptr), mEmbeddedSize(0), mFile(std::move(file))
+    {
+    }
+
+    const uint32_t *Data() const
+    {
+        return mEmbeddedCode
+                   ? mEmbeddedCode
+                   : reinterpret_cast<const uint32_t *>(mFile.Data());
+    }
+
+    size_t Size() const
+    {
+        return mEmbeddedCode ? mEmbeddedSize : mFile.Size();
+    }
+
+    bool IsEmbedded() const { return mEmbeddedCode != nullptr; }
+
+private:
+    const uint32_t *mEmbeddedCode;
+    size_t mEmbeddedSize;
+    TriMappedFile mFile;
+};
+
+// Embedded shader by name (e.g. "triangle.vert"), nullptr if there is none
+const TriEmbeddedShader *FindEmbeddedShader(const std::string &name);
+
+/* Look the shader up in the embedded registry first (unless allowEmbedded is
+   false, e.g. after a hot reload), then fall back to Shaders/<name>.svc
+   relative to the working directory
+*/
+std::optional<TriShaderCode> LoadShaderCode(const std::string &name,
+                                            bool allowEmbedded = true);
+
+/* Map the given shaders & read them in ahead of time, e.g. on a thread while
+   the device is being created. The next LoadShaderCode() of each name takes
+   the preloaded code instead of going to the disk. Embedded shaders need no
+   preloading and are skipped.
+*/
+void PreloadShaderCode(const std::vector<std::string> &names);
+
+// Drop preloaded shaders that were never loaded
+void ClearPreloadedShaderCode();
+
+/* Run glslc on <shader source dir>/<name> and atomically replace
+   Shaders/<name>.svc. Blocks until glslc exits; meant for worker threads.
+*/
+bool CompileShaderSource(const std::string &name);
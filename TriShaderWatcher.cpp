@@ -0,0 +1,102 @@
+#include "TriShaderWatcher.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+bool TriShaderWatcher::Init(const std::string &directory)
+{
+    Finalize();
+
+#ifdef __linux__
+    mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (mFd < 0)
+    {
+        TriLogError() << "inotify_init1 failed: " << std::strerror(errno);
+        return false;
+    }
+
+    mWatch = inotify_add_watch(mFd, directory.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (mWatch < 0)
+    {
+        TriLogError() << "Cannot watch " << directory << ": "
+                      << std::strerror(errno);
+        Finalize();
+        return false;
+    }
+
+    mDirectory = directory;
+    TriLogInfo() << "Watching " << mDirectory << " for shader changes";
+    return true;
+#else
+    TriLogWarning() << "Shader hot reload is not supported on this platform";
+    return false;
+#endif
+}
+
+void TriShaderWatcher::Finalize()
+{
+#ifdef __linux__
+    if (mFd >= 0)
+    {
+        // Closing the inotify instance also removes its watches
+        close(mFd);
+    }
+#endif
+
+    mFd = -1;
+    mWatch = -1;
+    mDirectory.clear();
+}
+
+std::vector<std::string> TriShaderWatcher::Poll()
+{
+    std::vector<std::string> changed;
+
+#ifdef __linux__
+    if (mFd < 0)
+        return changed;
+
+    alignas(struct inotify_event) char buffer[4096];
+
+    for (;;)
+    {
+        ssize_t length = read(mFd, buffer, sizeof(buffer));
+
+        // EAGAIN: nothing (more) to report
+        if (length <= 0)
+            break;
+
+        for (char *p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event *event =
+                reinterpret_cast<const struct inotify_event *>(p);
+
+            if (event->len > 0 && !(event->mask & IN_ISDIR))
+            {
+                std::string name = event->name;
+
+                // A single save usually fires several events
+                if (std::find(changed.begin(), changed.end(), name) ==
+                    changed.end())
+                {
+                    changed.emplace_back(std::move(name));
+                }
+            }
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+
+    return changed;
+}
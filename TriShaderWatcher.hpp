@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/* Watches a directory for files that have been written or moved into place
+   (editors often save through a rename). Poll() never blocks, so it can be
+   called once per frame. Only implemented on Linux (inotify); elsewhere
+   Init() fails and hot reload is unavailable.
+*/
+
+class TriShaderWatcher
+{
+public:
+    TriShaderWatcher() : mFd(-1), mWatch(-1), mDirectory() {}
+
+    ~TriShaderWatcher() { Finalize(); }
+
+    TriShaderWatcher(const TriShaderWatcher &) = delete;
+    TriShaderWatcher &operator=(const TriShaderWatcher &) = delete;
+
+public:
+    bool Init(const std::string &directory);
+
+    void Finalize();
+
+    // Names (relative to the directory) of files changed since the last poll
+    std::vector<std::string> Poll();
+
+    bool IsWatching() const { return mFd >= 0; }
+
+private:
+    int mFd;
+    int mWatch;
+    std::string mDirectory;
+};
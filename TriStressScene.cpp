@@ -0,0 +1,92 @@
+#include "TriStressScene.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+void TriStressScene::Generate(uint64_t count, float extent, uint32_t seed)
+{
+    mBase.clear();
+    mSpin.clear();
+
+    if (count == 0)
+        return;
+
+    if (count == 1)
+    {
+        TriInstance identity;
+        identity.transform = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+        identity.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+        mBase.emplace_back(identity);
+        mSpin.emplace_back(0.0f);
+        return;
+    }
+
+    mBase.resize(count);
+    mSpin.resize(count);
+
+    // Smallest square grid that fits every instance, spanning
+    // [-extent, extent]
+    uint64_t columns =
+        static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float cell = 2.0f * extent / columns;
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        float x = -extent + cell * (i % columns + 0.5f);
+        float y = -extent + cell * (i / columns + 0.5f);
+
+        TriInstance &instance = mBase[i];
+        instance.transform =
+            glm::vec4(x, y, cell * 0.9f, unit(random) * 6.2831853f);
+        instance.color =
+            glm::vec4(unit(random), unit(random), unit(random), 1.0f);
+
+        mSpin[i] = (unit(random) - 0.5f) * 4.0f;
+    }
+}
+
+uint64_t TriStressScene::CountVisible(float meshRadius) const
+{
+    uint64_t visible = 0;
+
+    // Positions never change, only the rotation does
+    for (const TriInstance &instance : mBase)
+    {
+        float limit = 1.0f + meshRadius * instance.transform.z;
+
+        if (std::abs(instance.transform.x) <= limit &&
+            std::abs(instance.transform.y) <= limit)
+        {
+            visible++;
+        }
+    }
+
+    return visible;
+}
+
+void TriStressScene::Write(TriInstance *instances, double time) const
+{
+    if (mBase.size() == 1)
+    {
+        std::memcpy(instances, mBase.data(), sizeof(TriInstance));
+        return;
+    }
+
+    float t = static_cast<float>(time);
+
+    for (size_t i = 0; i < mBase.size(); i++)
+    {
+        // Written field by field; the destination is (write-combined)
+        // device-visible memory, so never read it back
+        const TriInstance &base = mBase[i];
+        instances[i].transform =
+            glm::vec4(base.transform.x, base.transform.y, base.transform.z,
+                      base.transform.w + mSpin[i] * t);
+        instances[i].color = base.color;
+    }
+}
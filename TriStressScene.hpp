@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TriGeometry.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/* Generates a grid of instances covering the viewport, for scaling tests
+   from a single instance up to tens of millions. With one instance the
+   scene is the identity transform, i.e. the plain mesh.
+
+   The grid spans extent times the viewport; beyond 1 the outer instances
+   are off-screen, which is what GPU culling has to reject.
+*/
+
+class TriStressScene
+{
+public:
+    TriStressScene() : mBase(), mSpin() {}
+
+public:
+    void Generate(uint64_t count, float extent = 1.0f, uint32_t seed = 1);
+
+    uint64_t GetCount() const { return mBase.size(); }
+
+    /* Instances whose bounding circle touches the view volume, by the same
+       test as Shaders/cull.comp; i.e. how many GPU culling should keep
+    */
+    uint64_t CountVisible(float meshRadius) const;
+
+    // Write the scene at the given time (seconds) into mapped memory
+    void Write(TriInstance *instances, double time) const;
+
+private:
+    std::vector<TriInstance> mBase;
+
+    // Angular velocity per instance (radians per second)
+    std::vector<float> mSpin;
+};
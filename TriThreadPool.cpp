@@ -0,0 +1,68 @@
+#include "TriThreadPool.hpp"
+#include "TriCpuProfiler.hpp"
+
+#include <algorithm>
+
+void TriThreadPool::Init(uint32_t threadCount)
+{
+    if (!mWorkers.empty())
+        return;
+
+    if (threadCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = std::max(hardwareThreads, 2u) - 1;
+    }
+
+    mStopping = false;
+    mWorkers.reserve(threadCount);
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        mWorkers.emplace_back(&TriThreadPool::WorkerMain, this);
+    }
+}
+
+void TriThreadPool::Finalize()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+
+    mCondition.notify_all();
+
+    for (std::thread &worker : mWorkers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    mWorkers.clear();
+}
+
+void TriThreadPool::WorkerMain()
+{
+    TriCpuTraceSetThreadName("Worker");
+
+    for (;;)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock,
+                            [this]() { return mStopping || !mJobs.empty(); });
+
+            // Drain the queue before honoring a stop request
+            if (mJobs.empty())
+                return;
+
+            job = std::move(mJobs.front());
+            mJobs.pop();
+        }
+
+        TRI_CPU_SCOPE("Job");
+        job();
+    }
+}
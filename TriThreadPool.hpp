@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads draining a FIFO job queue
+
+class TriThreadPool
+{
+public:
+    TriThreadPool() : mWorkers(), mJobs(), mMutex(), mCondition(),
+                      mStopping(false)
+    {
+    }
+
+    ~TriThreadPool() { Finalize(); }
+
+    TriThreadPool(const TriThreadPool &) = delete;
+    TriThreadPool &operator=(const TriThreadPool &) = delete;
+
+public:
+    // 0 threads picks one less than the hardware concurrency (at least 1)
+    void Init(uint32_t threadCount);
+
+    // Finish queued jobs, then join all workers
+    void Finalize();
+
+    uint32_t GetThreadCount() const
+    {
+        return static_cast<uint32_t>(mWorkers.size());
+    }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F &&job)
+    {
+        using R = std::invoke_result_t<F>;
+
+        // std::function needs a copyable target, packaged_task is move-only
+        auto task =
+            std::make_shared<std::packaged_task<R()>>(std::forward<F>(job));
+        std::future<R> future = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.emplace([task]() { (*task)(); });
+        }
+
+        mCondition.notify_one();
+        return future;
+    }
+
+private:
+    void WorkerMain();
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::queue<std::function<void()>> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping;
+};
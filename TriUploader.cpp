@@ -0,0 +1,365 @@
+#include "TriUploader.hpp"
+#include "TriLog.hpp"
+
+#include <cstring>
+#include <limits>
+
+static VkResult CreateTransientPool(VkDevice device,
+                                    const VkAllocationCallbacks *hostAllocator,
+                                    uint32_t queueFamily, VkCommandPool &pool)
+{
+    VkCommandPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    createInfo.queueFamilyIndex = queueFamily;
+
+    VkResult result =
+        vkCreateCommandPool(device, &createInfo, hostAllocator, &pool);
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to create upload command pool";
+        pool = nullptr;
+    }
+
+    return result;
+}
+
+static VkCommandBuffer BeginOneTimeCommands(VkDevice device,
+                                            VkCommandPool pool)
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.commandPool = pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer = nullptr;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) !=
+        VK_SUCCESS)
+    {
+        TriLogError() << "Failed to allocate upload command buffer";
+        return nullptr;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+VkResult TriUploader::Init(TriMemoryAllocator *allocator,
+                           VkQueue transferQueue, uint32_t transferFamily,
+                           VkQueue graphicsQueue, uint32_t graphicsFamily)
+{
+    mAllocator = allocator;
+    mDevice = allocator->GetDevice();
+    mTransferQueue = transferQueue;
+    mGraphicsQueue = graphicsQueue;
+    mTransferFamily = transferFamily;
+    mGraphicsFamily = graphicsFamily;
+
+    VkResult result =
+        CreateTransientPool(mDevice, mAllocator->GetHostAllocator(),
+                            mTransferFamily, mTransferPool);
+    if (result != VK_SUCCESS || !IsAsync())
+        return result;
+
+    return CreateTransientPool(mDevice, mAllocator->GetHostAllocator(),
+                               mGraphicsFamily, mGraphicsPool);
+}
+
+void TriUploader::Finalize()
+{
+    Collect(true);
+
+    for (PendingCopy &copy : mPending)
+    {
+        DestroyBuffer(*mAllocator, copy.staging);
+    }
+    mPending.clear();
+
+    if (mTransferPool)
+    {
+        vkDestroyCommandPool(mDevice, mTransferPool,
+                             mAllocator->GetHostAllocator());
+        mTransferPool = nullptr;
+    }
+
+    if (mGraphicsPool)
+    {
+        vkDestroyCommandPool(mDevice, mGraphicsPool,
+                             mAllocator->GetHostAllocator());
+        mGraphicsPool = nullptr;
+    }
+
+    mAllocator = nullptr;
+    mDevice = nullptr;
+    mTransferQueue = nullptr;
+    mGraphicsQueue = nullptr;
+}
+
+VkResult TriUploader::Upload(const void *data, VkDeviceSize size,
+                             VkBufferUsageFlags usage, TriBuffer &buffer)
+{
+    PendingCopy copy{};
+    copy.size = size;
+
+    // Staging is short-lived, so it comes from linear (bump) blocks, which
+    // are persistently mapped
+    VkResult result = CreateBuffer(*mAllocator, size,
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   TriAllocLinear, copy.staging);
+    if (result != VK_SUCCESS)
+        return result;
+
+    std::memcpy(copy.staging.allocation.mapped, data, size);
+
+    result = CreateBuffer(*mAllocator, size,
+                          usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TriAllocFreeList,
+                          buffer);
+    if (result != VK_SUCCESS)
+    {
+        DestroyBuffer(*mAllocator, copy.staging);
+        return result;
+    }
+
+    copy.destination = buffer.buffer;
+    mPending.emplace_back(copy);
+
+    return VK_SUCCESS;
+}
+
+VkResult TriUploader::Flush()
+{
+    if (mPending.empty())
+        return VK_SUCCESS;
+
+    // Reclaim whatever finished in the meantime
+    Collect(false);
+
+    Batch batch{};
+    batch.copies.swap(mPending);
+
+    batch.transferCommands = BeginOneTimeCommands(mDevice, mTransferPool);
+    if (!batch.transferCommands)
+    {
+        ReleaseBatch(batch);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    for (const PendingCopy &copy : batch.copies)
+    {
+        VkBufferCopy region{};
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size = copy.size;
+
+        vkCmdCopyBuffer(batch.transferCommands, copy.staging.buffer,
+                        copy.destination, 1, &region);
+    }
+
+    if (IsAsync())
+    {
+        // Release the buffers to the graphics family; the matching acquire
+        // happens in SubmitAcquire()
+        std::vector<VkBufferMemoryBarrier> releases(batch.copies.size());
+        for (size_t i = 0; i < batch.copies.size(); i++)
+        {
+            VkBufferMemoryBarrier &release = releases[i];
+            release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            release.pNext = nullptr;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+            release.srcQueueFamilyIndex = mTransferFamily;
+            release.dstQueueFamilyIndex = mGraphicsFamily;
+            release.buffer = batch.copies[i].destination;
+            release.offset = 0;
+            release.size = VK_WHOLE_SIZE;
+        }
+
+        vkCmdPipelineBarrier(batch.transferCommands,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                             nullptr, releases.size(), releases.data(), 0,
+                             nullptr);
+    }
+    else
+    {
+        // Make the copies visible to vertex input & index fetch of later
+        // frames
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                VK_ACCESS_INDEX_READ_BIT;
+
+        vkCmdPipelineBarrier(batch.transferCommands,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    vkEndCommandBuffer(batch.transferCommands);
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+
+    VkResult result = vkCreateFence(mDevice, &fenceCreateInfo,
+                                    mAllocator->GetHostAllocator(),
+                                    &batch.fence);
+
+    if (result == VK_SUCCESS && IsAsync())
+    {
+        VkSemaphoreCreateInfo semaCreateInfo{};
+        semaCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaCreateInfo.pNext = nullptr;
+
+        result = vkCreateSemaphore(mDevice, &semaCreateInfo,
+                                   mAllocator->GetHostAllocator(),
+                                   &batch.transferDone);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = nullptr;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transferCommands;
+
+        if (batch.transferDone)
+        {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch.transferDone;
+        }
+
+        // With a separate family the fence goes on the acquire instead,
+        // which completes after the copy
+        result = vkQueueSubmit(mTransferQueue, 1, &submitInfo,
+                               IsAsync() ? nullptr : batch.fence);
+    }
+
+    if (result == VK_SUCCESS && IsAsync())
+        result = SubmitAcquire(batch);
+
+    if (result != VK_SUCCESS)
+    {
+        TriLogError() << "Failed to submit uploads";
+
+        // Nothing may be pending on the GPU if the fence can't be trusted
+        vkDeviceWaitIdle(mDevice);
+        ReleaseBatch(batch);
+        return result;
+    }
+
+    TriLogVerbose() << "Flushed " << batch.copies.size() << " upload(s)"
+                    << (IsAsync() ? " on the transfer queue" : "");
+
+    mBatches.emplace_back(std::move(batch));
+
+    return VK_SUCCESS;
+}
+
+VkResult TriUploader::SubmitAcquire(Batch &batch)
+{
+    batch.acquireCommands = BeginOneTimeCommands(mDevice, mGraphicsPool);
+    if (!batch.acquireCommands)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    std::vector<VkBufferMemoryBarrier> acquires(batch.copies.size());
+    for (size_t i = 0; i < batch.copies.size(); i++)
+    {
+        VkBufferMemoryBarrier &acquire = acquires[i];
+        acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        acquire.pNext = nullptr;
+        acquire.srcAccessMask = 0;
+        acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                VK_ACCESS_INDEX_READ_BIT;
+        acquire.srcQueueFamilyIndex = mTransferFamily;
+        acquire.dstQueueFamilyIndex = mGraphicsFamily;
+        acquire.buffer = batch.copies[i].destination;
+        acquire.offset = 0;
+        acquire.size = VK_WHOLE_SIZE;
+    }
+
+    // Later submissions to the graphics queue are ordered after this barrier,
+    // which in turn is chained to the semaphore wait below
+    vkCmdPipelineBarrier(batch.acquireCommands,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr,
+                         acquires.size(), acquires.data(), 0, nullptr);
+
+    vkEndCommandBuffer(batch.acquireCommands);
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &batch.transferDone;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.acquireCommands;
+
+    return vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, batch.fence);
+}
+
+void TriUploader::Collect(bool wait)
+{
+    for (size_t i = 0; i < mBatches.size();)
+    {
+        Batch &batch = mBatches[i];
+
+        VkResult status = wait ? vkWaitForFences(
+                                     mDevice, 1, &batch.fence, true,
+                                     std::numeric_limits<uint64_t>::max())
+                               : vkGetFenceStatus(mDevice, batch.fence);
+
+        if (status != VK_SUCCESS)
+        {
+            i++;
+            continue;
+        }
+
+        ReleaseBatch(batch);
+        mBatches.erase(mBatches.begin() + i);
+    }
+}
+
+void TriUploader::ReleaseBatch(Batch &batch)
+{
+    for (PendingCopy &copy : batch.copies)
+    {
+        DestroyBuffer(*mAllocator, copy.staging);
+    }
+    batch.copies.clear();
+
+    if (batch.transferCommands)
+        vkFreeCommandBuffers(mDevice, mTransferPool, 1,
+                             &batch.transferCommands);
+
+    if (batch.acquireCommands)
+        vkFreeCommandBuffers(mDevice, mGraphicsPool, 1,
+                             &batch.acquireCommands);
+
+    if (batch.transferDone)
+        vkDestroySemaphore(mDevice, batch.transferDone,
+                           mAllocator->GetHostAllocator());
+
+    if (batch.fence)
+        vkDestroyFence(mDevice, batch.fence, mAllocator->GetHostAllocator());
+
+    batch = Batch{};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "TriBuffer.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+/* Fills device-local buffers through host-visible staging buffers. Upload()
+   only queues a copy; Flush() records every queued copy into one command
+   buffer and submits it, so a batch of uploads costs one submission.
+
+   Copies run on the transfer queue. When that is a dedicated family, the
+   destination buffers are released to the graphics family after the copy
+   and acquired by a small graphics submission that waits on the copy's
+   semaphore; work submitted to the graphics queue afterwards sees the data
+   without the CPU waiting for the copy. Staging memory is reclaimed once a
+   batch has completed (Collect()).
+*/
+
+class TriUploader
+{
+public:
+    TriUploader()
+        : mAllocator(nullptr), mDevice(nullptr), mTransferQueue(nullptr),
+          mGraphicsQueue(nullptr), mTransferFamily(0), mGraphicsFamily(0),
+          mTransferPool(nullptr), mGraphicsPool(nullptr), mPending(),
+          mBatches()
+    {
+    }
+
+    ~TriUploader() { Finalize(); }
+
+public:
+    VkResult Init(TriMemoryAllocator *allocator, VkQueue transferQueue,
+                  uint32_t transferFamily, VkQueue graphicsQueue,
+                  uint32_t graphicsFamily);
+
+    // Waits for in-flight batches; drops uploads that were never flushed
+    void Finalize();
+
+    /* Create a DEVICE_LOCAL buffer of size bytes with usage (plus
+       TRANSFER_DST) and queue a copy of data into it
+    */
+    VkResult Upload(const void *data, VkDeviceSize size,
+                    VkBufferUsageFlags usage, TriBuffer &buffer);
+
+    // Submit all queued copies; does not wait for them
+    VkResult Flush();
+
+    // Free the staging memory of completed batches; wait for all if asked
+    void Collect(bool wait);
+
+    bool IsAsync() const { return mTransferFamily != mGraphicsFamily; }
+
+private:
+    struct PendingCopy
+    {
+        TriBuffer staging;
+        VkBuffer destination;
+        VkDeviceSize size;
+    };
+
+    // One Flush(): its copies, and what signals that they are done
+    struct Batch
+    {
+        std::vector<PendingCopy> copies;
+        VkCommandBuffer transferCommands;
+        VkCommandBuffer acquireCommands;
+        VkSemaphore transferDone;
+        VkFence fence;
+    };
+
+    VkResult SubmitAcquire(Batch &batch);
+
+    void ReleaseBatch(Batch &batch);
+
+private:
+    TriMemoryAllocator *mAllocator;
+    VkDevice mDevice;
+    VkQueue mTransferQueue;
+    VkQueue mGraphicsQueue;
+    uint32_t mTransferFamily;
+    uint32_t mGraphicsFamily;
+
+    // The acquire side of ownership transfers records on the graphics family
+    VkCommandPool mTransferPool;
+    VkCommandPool mGraphicsPool;
+
+    std::vector<PendingCopy> mPending;
+    std::vector<Batch> mBatches;
+};
@@ -1,8 +1,71 @@
 #include "VkExtLibrary.hpp"
+#include "TriLog.hpp"
 
-void VkExtLibary::Init() {}
+#include <string>
+
+template <typename PFN>
+static bool LoadDeviceFunc(VkDevice device, const char *name, PFN &func)
+{
+    func = reinterpret_cast<PFN>(vkGetDeviceProcAddr(device, name));
+
+    if (!func)
+        TriLogError() << "Device function not found: " << name;
+
+    return func != nullptr;
+}
+
+void VkExtLibary::Init(VkInstance instance)
+{
+#define VK_EXT_LOAD_INSTANCE_FUNC(funcName)                                    \
+    funcName = reinterpret_cast<PFN_vk##funcName>(                             \
+        vkGetInstanceProcAddr(instance, "vk" #funcName));
+
+    VK_EXT_INSTANCE_FUNC_ITERATE(VK_EXT_LOAD_INSTANCE_FUNC)
+
+#undef VK_EXT_LOAD_INSTANCE_FUNC
+}
+
+bool VkExtLibary::InitDevice(VkDevice device, bool swapchain,
+                             bool dynamicRendering, bool dynamicRenderingKHR)
+{
+    bool complete = true;
+
+#define VK_EXT_LOAD_DEVICE_FUNC(funcName)                                      \
+    complete &= LoadDeviceFunc(device, "vk" #funcName, funcName);
+
+    VK_EXT_DEVICE_FUNC_ITERATE(VK_EXT_LOAD_DEVICE_FUNC)
+
+    if (swapchain)
+    {
+        VK_EXT_SWAPCHAIN_FUNC_ITERATE(VK_EXT_LOAD_DEVICE_FUNC)
+    }
+
+#undef VK_EXT_LOAD_DEVICE_FUNC
+
+    if (dynamicRendering)
+    {
+        const char *suffix = dynamicRenderingKHR ? "KHR" : "";
+
+#define VK_EXT_LOAD_RENDERING_FUNC(funcName)                                   \
+    funcName = reinterpret_cast<PFN_vk##funcName>(vkGetDeviceProcAddr(         \
+        device, (std::string("vk" #funcName) + suffix).c_str()));
+
+        VK_EXT_DYNAMIC_RENDERING_FUNC_ITERATE(VK_EXT_LOAD_RENDERING_FUNC)
+
+#undef VK_EXT_LOAD_RENDERING_FUNC
+    }
+
+    return complete;
+}
 
 void VkExtLibary::Finalize()
 {
-    mFuncs.clear();
+#define VK_EXT_RESET_FUNC(funcName) funcName = nullptr;
+
+    VK_EXT_INSTANCE_FUNC_ITERATE(VK_EXT_RESET_FUNC)
+    VK_EXT_DEVICE_FUNC_ITERATE(VK_EXT_RESET_FUNC)
+    VK_EXT_SWAPCHAIN_FUNC_ITERATE(VK_EXT_RESET_FUNC)
+    VK_EXT_DYNAMIC_RENDERING_FUNC_ITERATE(VK_EXT_RESET_FUNC)
+
+#undef VK_EXT_RESET_FUNC
 }
@@ -1,79 +1,90 @@
 #pragma once
 
-#include "TriLog.hpp"
 #include "vulkan/vulkan_core.h"
 
 #include <vulkan/vulkan.h>
 
-#include <string>
-#include <unordered_map>
+/* Entry points resolved once into flat tables of typed PFN_vk* pointers, so
+   that a call is a single indirect jump. Device-level functions come from
+   vkGetDeviceProcAddr and skip the loader trampoline (& its dispatch through
+   the device handle).
 
-#define VK_EXT_FUNC_ITERATE(funcName, params, args)                            \
-    VkResult funcName params                                                   \
-    {                                                                          \
-        void *func = mFuncs[#funcName];                                        \
-        if (!func)                                                             \
-        {                                                                      \
-            func = reinterpret_cast<void *>(                                   \
-                vkGetInstanceProcAddr(instance, "vk" #funcName));              \
-            if (!func)                                                         \
-            {                                                                  \
-                TriLogError()                                                  \
-                    << "Extension function not found: " << "vk" #funcName;     \
-                return VK_ERROR_EXTENSION_NOT_PRESENT;                         \
-            }                                                                  \
-            mFuncs[#funcName] = func;                                          \
-        }                                                                      \
-        return reinterpret_cast<PFN_vk##funcName>(func) args;                  \
-    }
+   Instance-level functions; extensions, resolved by Init()
+*/
+#define VK_EXT_INSTANCE_FUNC_ITERATE(X)                                        \
+    X(CreateDebugUtilsMessengerEXT)                                            \
+    X(DestroyDebugUtilsMessengerEXT)
 
-#define VK_EXT_FUNC_ITERATE_VOID(funcName, params, args)                       \
-    void funcName params                                                       \
-    {                                                                          \
-        void *func = mFuncs[#funcName];                                        \
-        if (!func)                                                             \
-        {                                                                      \
-            func = reinterpret_cast<void *>(                                   \
-                vkGetInstanceProcAddr(instance, "vk" #funcName));              \
-            if (!func)                                                         \
-            {                                                                  \
-                TriLogError()                                                  \
-                    << "Extension function not found: " << "vk" #funcName;     \
-                return;                                                        \
-            }                                                                  \
-            mFuncs[#funcName] = func;                                          \
-        }                                                                      \
-        reinterpret_cast<PFN_vk##funcName>(func) args;                         \
-    }
+// Device-level functions of the per-frame path, resolved by InitDevice()
+#define VK_EXT_DEVICE_FUNC_ITERATE(X)                                          \
+    X(WaitForFences)                                                           \
+    X(ResetFences)                                                             \
+    X(ResetCommandBuffer)                                                      \
+    X(BeginCommandBuffer)                                                      \
+    X(EndCommandBuffer)                                                        \
+    X(QueueSubmit)                                                             \
+    X(CmdBeginRenderPass)                                                      \
+    X(CmdEndRenderPass)                                                        \
+    X(CmdBindPipeline)                                                         \
+    X(CmdSetViewport)                                                          \
+    X(CmdSetScissor)                                                           \
+    X(CmdBindVertexBuffers)                                                    \
+    X(CmdBindIndexBuffer)                                                      \
+    X(CmdBindDescriptorSets)                                                   \
+    X(CmdPushConstants)                                                        \
+    X(CmdDrawIndexed)                                                          \
+    X(CmdDrawIndexedIndirect)                                                  \
+    X(CmdDispatch)                                                             \
+    X(CmdUpdateBuffer)                                                         \
+    X(CmdPipelineBarrier)                                                      \
+    X(CmdWriteTimestamp)                                                       \
+    X(CmdResetQueryPool)                                                       \
+    X(CmdBeginQuery)                                                           \
+    X(CmdEndQuery)                                                             \
+    X(GetQueryPoolResults)
+
+// Device-level functions that only exist with VK_KHR_swapchain
+#define VK_EXT_SWAPCHAIN_FUNC_ITERATE(X)                                       \
+    X(AcquireNextImageKHR)                                                     \
+    X(QueuePresentKHR)
+
+// Core in 1.3, VK_KHR_dynamic_rendering ("...KHR") before that
+#define VK_EXT_DYNAMIC_RENDERING_FUNC_ITERATE(X)                               \
+    X(CmdBeginRendering)                                                       \
+    X(CmdEndRendering)
+
+#define VK_EXT_DECLARE_FUNC(funcName) PFN_vk##funcName funcName = nullptr;
 
-// Class that loads Vulkan extension functions
+// Class that loads Vulkan instance (extension) & device functions
 
 class VkExtLibary
 {
 public:
-    VkExtLibary() : mFuncs() {}
+    VkExtLibary() {}
 
     ~VkExtLibary() { Finalize(); }
 
 public:
-    void Init();
-    void Finalize();
+    // Missing extension functions are left null; callers check before use
+    void Init(VkInstance instance);
 
-public:
-    VK_EXT_FUNC_ITERATE(
-        CreateDebugUtilsMessengerEXT,
-        (VkInstance instance,
-         const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
-         const VkAllocationCallbacks *pAllocator,
-         VkDebugUtilsMessengerEXT *pDebugMessenger),
-         (instance, pCreateInfo, pAllocator, pDebugMessenger));
+    /* Swap chain & dynamic rendering functions are only resolved when asked
+       for (the latter with the KHR suffix if dynamicRenderingKHR). Returns
+       false if a core or swap chain function is missing; missing dynamic
+       rendering functions show up in HasDynamicRendering() instead.
+    */
+    bool InitDevice(VkDevice device, bool swapchain, bool dynamicRendering,
+                    bool dynamicRenderingKHR);
+    void Finalize();
 
-    VK_EXT_FUNC_ITERATE_VOID(DestroyDebugUtilsMessengerEXT,
-                        (VkInstance instance,
-                         VkDebugUtilsMessengerEXT debugMessenger,
-                         const VkAllocationCallbacks *pAllocator),
-                         (instance, debugMessenger, pAllocator));
+    bool HasDynamicRendering() const
+    {
+        return CmdBeginRendering && CmdEndRendering;
+    }
 
-private:
-    std::unordered_map<std::string, void *> mFuncs;
+public:
+    VK_EXT_INSTANCE_FUNC_ITERATE(VK_EXT_DECLARE_FUNC)
+    VK_EXT_DEVICE_FUNC_ITERATE(VK_EXT_DECLARE_FUNC)
+    VK_EXT_SWAPCHAIN_FUNC_ITERATE(VK_EXT_DECLARE_FUNC)
+    VK_EXT_DYNAMIC_RENDERING_FUNC_ITERATE(VK_EXT_DECLARE_FUNC)
 };
@@ -0,0 +1,381 @@
+#include "TriLog.hpp"
+#include "TriMemoryAllocator.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* tri_allocator_test: TriMemoryAllocator's sub-allocation logic against a
+   fake driver, so that it runs without a GPU. Memory type 0 is device-local
+   on a large heap, type 1 host-visible on a 128 MiB heap.
+*/
+
+static VkDeviceSize gGranularity = 1;
+static uint64_t gLiveAllocations = 0;
+static bool gFailMaps = false;
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+    (void)physicalDevice;
+
+    *pMemoryProperties = VkPhysicalDeviceMemoryProperties{};
+    pMemoryProperties->memoryTypeCount = 2;
+    pMemoryProperties->memoryTypes[0].propertyFlags =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    pMemoryProperties->memoryTypes[0].heapIndex = 0;
+    pMemoryProperties->memoryTypes[1].propertyFlags =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    pMemoryProperties->memoryTypes[1].heapIndex = 1;
+
+    pMemoryProperties->memoryHeapCount = 2;
+    pMemoryProperties->memoryHeaps[0].size = 8ull << 30;
+    pMemoryProperties->memoryHeaps[1].size = 128ull << 20;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(
+    VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties *pProperties)
+{
+    (void)physicalDevice;
+
+    std::memset(pProperties, 0, sizeof(*pProperties));
+    pProperties->limits.bufferImageGranularity = gGranularity;
+    pProperties->limits.maxMemoryAllocationCount = 4096;
+}
+
+// Only the handle matters; nothing is ever mapped for real
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(
+    VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+    const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory)
+{
+    (void)device;
+    (void)pAllocateInfo;
+    (void)pAllocator;
+
+    *pMemory = reinterpret_cast<VkDeviceMemory>(std::malloc(1));
+    gLiveAllocations++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+                                        const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+
+    if (!memory)
+        return;
+
+    std::free(reinterpret_cast<void *>(memory));
+    gLiveAllocations--;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device,
+                                           VkDeviceMemory memory,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize size,
+                                           VkMemoryMapFlags flags,
+                                           void **ppData)
+{
+    (void)device;
+    (void)memory;
+    (void)offset;
+    (void)size;
+    (void)flags;
+
+    if (gFailMaps)
+        return VK_ERROR_MEMORY_MAP_FAILED;
+
+    // Never written through; large enough for offsets into any block
+    static char mapped[64 * 1024 * 1024];
+    *ppData = mapped;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device,
+                                         VkDeviceMemory memory)
+{
+    (void)device;
+    (void)memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(
+    VkDevice device, VkBuffer buffer, VkMemoryRequirements *pMemoryRequirements)
+{
+    (void)device;
+    (void)buffer;
+
+    *pMemoryRequirements = VkMemoryRequirements{};
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device,
+                                                  VkBuffer buffer,
+                                                  VkDeviceMemory memory,
+                                                  VkDeviceSize memoryOffset)
+{
+    (void)device;
+    (void)buffer;
+    (void)memory;
+    (void)memoryOffset;
+
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(
+    VkDevice device, VkImage image, VkMemoryRequirements *pMemoryRequirements)
+{
+    (void)device;
+    (void)image;
+
+    *pMemoryRequirements = VkMemoryRequirements{};
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device,
+                                                 VkImage image,
+                                                 VkDeviceMemory memory,
+                                                 VkDeviceSize memoryOffset)
+{
+    (void)device;
+    (void)image;
+    (void)memory;
+    (void)memoryOffset;
+
+    return VK_SUCCESS;
+}
+
+static int gFailures = 0;
+
+#define TRI_CHECK(condition)                                                   \
+    do                                                                         \
+    {                                                                          \
+        if (!(condition))                                                      \
+        {                                                                      \
+            TriLogError() << __FILE__ << ":" << __LINE__                       \
+                          << ": check failed: " #condition;                    \
+            gFailures++;                                                       \
+        }                                                                      \
+    } while (false)
+
+#define TRI_MIB (1024ull * 1024)
+
+static VkMemoryRequirements Reqs(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkMemoryRequirements reqs{};
+    reqs.size = size;
+    reqs.alignment = alignment;
+    reqs.memoryTypeBits = ~0u;
+    return reqs;
+}
+
+static TriAllocation Allocate(TriMemoryAllocator &allocator,
+                              VkDeviceSize size, VkDeviceSize alignment,
+                              ETriResourceKind kind,
+                              VkMemoryPropertyFlags props =
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+{
+    TriAllocation allocation;
+    VkResult result = allocator.Allocate(Reqs(size, alignment), props, kind,
+                                         TriAllocFreeList, allocation);
+    TRI_CHECK(result == VK_SUCCESS);
+    return allocation;
+}
+
+static void TestAlignment()
+{
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr, 4 * TRI_MIB);
+
+    TriAllocation small = Allocate(allocator, 100, 1, TriResourceLinear);
+    TriAllocation aligned = Allocate(allocator, 1000, 4096, TriResourceLinear);
+    TriAllocation odd = Allocate(allocator, 10, 256, TriResourceLinear);
+
+    TRI_CHECK(small.offset == 0);
+    TRI_CHECK(aligned.memory == small.memory);
+    TRI_CHECK(aligned.offset == 4096);
+    // First fit: the gap left in front of the aligned allocation
+    TRI_CHECK(odd.offset == 256);
+
+    allocator.Free(small);
+    allocator.Free(aligned);
+    allocator.Free(odd);
+}
+
+static void TestGranularity()
+{
+    gGranularity = 1024;
+
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr, 4 * TRI_MIB);
+
+    // Same kinds pack tightly, linear & optimal never share a 1 KiB page
+    TriAllocation buffer = Allocate(allocator, 100, 1, TriResourceLinear);
+    TriAllocation buffer2 = Allocate(allocator, 100, 1, TriResourceLinear);
+    TriAllocation image = Allocate(allocator, 100, 1, TriResourceOptimal);
+    // Too large for the gap before the image, so it goes after it
+    TriAllocation buffer3 = Allocate(allocator, 900, 1, TriResourceLinear);
+
+    TRI_CHECK(buffer2.offset == 100);
+    TRI_CHECK(image.offset == 1024);
+    TRI_CHECK(buffer3.offset == 2048);
+
+    // Nor may an image take the gap right after the first buffer
+    allocator.Free(buffer2);
+    TriAllocation image2 = Allocate(allocator, 100, 1, TriResourceOptimal);
+    TRI_CHECK(image2.offset == 1124);
+
+    allocator.Free(buffer);
+    allocator.Free(image);
+    allocator.Free(buffer3);
+    allocator.Free(image2);
+
+    gGranularity = 1;
+}
+
+// Frees two neighbours in the given order, then needs them merged
+static void TestCoalescing(bool freeLowerFirst)
+{
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr, 4 * TRI_MIB);
+
+    TriAllocation a = Allocate(allocator, TRI_MIB, 1, TriResourceLinear);
+    TriAllocation b = Allocate(allocator, TRI_MIB, 1, TriResourceLinear);
+    TriAllocation c = Allocate(allocator, 2 * TRI_MIB, 1, TriResourceLinear);
+
+    TRI_CHECK(b.offset == TRI_MIB);
+    TRI_CHECK(c.offset == 2 * TRI_MIB);
+
+    allocator.Free(freeLowerFirst ? a : b);
+    allocator.Free(freeLowerFirst ? b : a);
+
+    // Only fits if [0, 1 MiB) & [1 MiB, 2 MiB) became one range
+    TriAllocation merged = Allocate(allocator, 2 * TRI_MIB, 1,
+                                    TriResourceLinear);
+    TRI_CHECK(merged.memory == c.memory);
+    TRI_CHECK(merged.offset == 0);
+    TRI_CHECK(allocator.GetHeapStats(0).blockCount == 1);
+
+    allocator.Free(merged);
+    allocator.Free(c);
+}
+
+static void TestSmallHeap()
+{
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr);
+
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+    /* The 128 MiB heap gets 16 MiB blocks, not the nominal 64 MiB; 20 MiB is
+       below half the nominal size but would never fit one of its blocks
+    */
+    TRI_CHECK(allocator.BlockSizeFor(1) == 16 * TRI_MIB);
+
+    uint64_t liveBefore = gLiveAllocations;
+    TriAllocation large = Allocate(allocator, 20 * TRI_MIB, 1,
+                                   TriResourceLinear, hostVisible);
+    TRI_CHECK(large.memory != nullptr);
+    TRI_CHECK(large.block == nullptr);
+    TRI_CHECK(allocator.GetHeapStats(1).blockCount == 0);
+    TRI_CHECK(gLiveAllocations == liveBefore + 1);
+
+    TriAllocation pooled = Allocate(allocator, 8 * TRI_MIB, 1,
+                                    TriResourceLinear, hostVisible);
+    TRI_CHECK(pooled.block != nullptr);
+
+    allocator.Free(large);
+    allocator.Free(pooled);
+}
+
+// Neither a block nor a dedicated allocation is handed out unmapped
+static void TestMapFailure()
+{
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr);
+
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    uint64_t liveBefore = gLiveAllocations;
+    gFailMaps = true;
+
+    for (VkDeviceSize size : {TRI_MIB, 20 * TRI_MIB})
+    {
+        TriAllocation allocation;
+        VkResult result =
+            allocator.Allocate(Reqs(size, 1), hostVisible, TriResourceLinear,
+                               TriAllocFreeList, allocation);
+
+        TRI_CHECK(result == VK_ERROR_MEMORY_MAP_FAILED);
+        TRI_CHECK(allocation.memory == nullptr);
+    }
+
+    gFailMaps = false;
+
+    TRI_CHECK(allocator.GetHeapStats(1).blockCount == 0);
+    TRI_CHECK(gLiveAllocations == liveBefore);
+
+    TriAllocation pooled = Allocate(allocator, TRI_MIB, 1, TriResourceLinear,
+                                    hostVisible);
+    TRI_CHECK(pooled.mapped != nullptr);
+    allocator.Free(pooled);
+}
+
+static void TestDefragment()
+{
+    TriMemoryAllocator allocator;
+    allocator.Init(nullptr, nullptr, nullptr, 4 * TRI_MIB);
+
+    TriAllocation a = Allocate(allocator, TRI_MIB, 1, TriResourceLinear);
+    TriAllocation b = Allocate(allocator, TRI_MIB, 1, TriResourceLinear);
+    allocator.Free(a);
+
+    // A refused move leaves everything in place
+    uint32_t moved = allocator.Defragment(
+        [](const TriAllocation &, const TriAllocation &) { return false; });
+    TRI_CHECK(moved == 0);
+
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> moves;
+    moved = allocator.Defragment(
+        [&](const TriAllocation &from, const TriAllocation &to)
+        {
+            moves.emplace_back(from.offset, to.offset);
+            return true;
+        });
+
+    TRI_CHECK(moved == 1);
+    TRI_CHECK(moves.size() == 1 && moves[0].first == TRI_MIB &&
+              moves[0].second == 0);
+
+    // b now lives at 0; its old range is free again
+    b.offset = 0;
+    TriAllocation next = Allocate(allocator, 3 * TRI_MIB / 2, 1,
+                                  TriResourceLinear);
+    TRI_CHECK(next.memory == b.memory);
+    TRI_CHECK(next.offset == TRI_MIB);
+
+    allocator.Free(b);
+    allocator.Free(next);
+}
+
+int main()
+{
+    TestAlignment();
+    TestGranularity();
+    TestCoalescing(true);
+    TestCoalescing(false);
+    TestSmallHeap();
+    TestMapFailure();
+    TestDefragment();
+
+    // Every block & dedicated allocation went back to the driver
+    TRI_CHECK(gLiveAllocations == 0);
+
+    if (gFailures != 0)
+    {
+        TriLogError() << gFailures << " allocator check(s) failed";
+        return 1;
+    }
+
+    TriLogInfo() << "Allocator checks passed";
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include "TriApp.hpp"
+#include "TriFileUtils.hpp"
+#include "TriFrameStats.hpp"
+#include "TriLog.hpp"
+#include "TriSettings.hpp"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Frames skipped in a row before the run is given up on (e.g. every submit
+// fails); a bench must never spin forever
+#define TRI_BENCH_MAX_SKIPPED_FRAMES 1000
+
+/* tri_bench: drives TriApp::RenderFrame() for a fixed number of frames (or a
+   fixed duration) and writes frame time percentiles as JSON. Headless by
+   default so that it runs on software drivers such as lavapipe.
+
+   Bench-only arguments are consumed here; everything else is forwarded to
+   ParseSettings().
+*/
+
+struct BenchOptions
+{
+    uint64_t frames = 0;
+    double durationSeconds = 0.0;
+    uint64_t warmupFrames = 30;
+    std::string outputPath = "tri_bench.json";
+    bool windowed = false;
+};
+
+static void WriteSeries(std::ofstream &out, const char *name,
+                        TriSampleSeries &series, bool last = false)
+{
+    out << "  \"" << name << "\": {"
+        << "\"min\": " << series.Min() << ", "
+        << "\"mean\": " << series.Mean() << ", "
+        << "\"p50\": " << series.Percentile(50.0) << ", "
+        << "\"p95\": " << series.Percentile(95.0) << ", "
+        << "\"p99\": " << series.Percentile(99.0) << ", "
+        << "\"max\": " << series.Max() << "}" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    std::vector<char *> forwarded{argv[0]};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--duration" && i + 1 < argc)
+        {
+            float value = 0.0f;
+            if (!ParseFloat(argv[++i], value))
+                return 1;
+
+            if (!(value > 0.0f))
+            {
+                TriLogError() << "Bench duration must be positive";
+                return 1;
+            }
+
+            options.durationSeconds = value;
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            long long value = 0;
+            if (!ParseInteger(argv[++i], value))
+                return 1;
+
+            if (value < 0)
+            {
+                TriLogError() << "Warmup frame count must not be negative";
+                return 1;
+            }
+
+            options.warmupFrames = static_cast<uint64_t>(value);
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            options.outputPath = argv[++i];
+        }
+        else if (arg == "--windowed")
+        {
+            options.windowed = true;
+        }
+        else
+        {
+            forwarded.emplace_back(argv[i]);
+        }
+    }
+
+    TriSettings settings;
+    settings.headless = !options.windowed;
+
+    if (!ParseSettings(forwarded.size(), forwarded.data(), settings))
+    {
+        TriLogInfo() << "Bench options: --duration <s> --warmup <n> "
+                        "--output <path> --windowed";
+        return 1;
+    }
+
+    TriLogStart(settings.log);
+
+    // Measured frames come from --frames; the app itself must not stop early
+    options.frames = settings.maxFrames;
+    settings.maxFrames = 0;
+
+    if (options.frames == 0 && options.durationSeconds <= 0.0)
+    {
+        options.frames = 1000;
+    }
+
+    std::unique_ptr<TriApp> triApp =
+        std::make_unique<TriApp>("Tri Bench", 800, 600, settings);
+
+    triApp->Init();
+
+    if (!triApp->IsRunning())
+    {
+        TriLogError() << "Initialization failed; nothing to benchmark";
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < options.warmupFrames && triApp->IsRunning(); i++)
+    {
+        triApp->PollEvents();
+        triApp->RenderFrame();
+    }
+
+    TriSampleSeries cpuFrame;
+    TriSampleSeries fenceWait;
+    TriSampleSeries acquire;
+    TriSampleSeries present;
+    TriSampleSeries instanceUpdate;
+    TriSampleSeries record;
+    TriSampleSeries submit;
+    TriSampleSeries cpuBusy;
+    TriSampleSeries gpuFrame;
+    TriSampleSeries gpuCull;
+    TriSampleSeries gpuDraw;
+
+    if (options.frames != 0)
+    {
+        cpuFrame.Reserve(options.frames);
+        fenceWait.Reserve(options.frames);
+        acquire.Reserve(options.frames);
+        present.Reserve(options.frames);
+        instanceUpdate.Reserve(options.frames);
+        record.Reserve(options.frames);
+        submit.Reserve(options.frames);
+        cpuBusy.Reserve(options.frames);
+        gpuFrame.Reserve(options.frames);
+        gpuCull.Reserve(options.frames);
+        gpuDraw.Reserve(options.frames);
+    }
+
+    TriClock::time_point start = TriClock::now();
+    uint64_t skippedFrames = 0;
+    uint64_t skippedInARow = 0;
+
+    while (triApp->IsRunning())
+    {
+        if (options.frames != 0 && cpuFrame.Count() >= options.frames)
+            break;
+
+        if (options.durationSeconds > 0.0 &&
+            TriElapsedMs(start) >= options.durationSeconds * 1000.0)
+            break;
+
+        triApp->PollEvents();
+        triApp->RenderFrame();
+
+        const TriFrameTimings &timings = triApp->GetLastFrameTimings();
+        if (!timings.rendered)
+        {
+            skippedFrames++;
+
+            if (++skippedInARow >= TRI_BENCH_MAX_SKIPPED_FRAMES)
+                break;
+
+            continue;
+        }
+
+        skippedInARow = 0;
+
+        cpuFrame.Add(timings.cpuFrameMs);
+        fenceWait.Add(timings.fenceWaitMs);
+        acquire.Add(timings.acquireMs);
+        present.Add(timings.presentMs);
+        instanceUpdate.Add(timings.instanceUpdateMs);
+        record.Add(timings.recordMs);
+        submit.Add(timings.submitMs);
+
+        // Not blocked on the GPU or the presentation engine
+        cpuBusy.Add(timings.cpuFrameMs - timings.fenceWaitMs -
+                    timings.acquireMs - timings.presentMs);
+
+        // GPU timings trail by framesInFlight frames; the first few are not
+        // there yet
+        if (timings.gpuTimed)
+        {
+            gpuFrame.Add(timings.gpuFrameMs);
+            gpuCull.Add(timings.gpuCullMs);
+            gpuDraw.Add(timings.gpuDrawMs);
+        }
+    }
+
+    if (triApp->HasFatalError() ||
+        skippedInARow >= TRI_BENCH_MAX_SKIPPED_FRAMES)
+    {
+        TriLogError() << "Benchmark aborted after " << cpuFrame.Count()
+                      << " measured frames (" << skippedInARow
+                      << " skipped in a row)";
+        return 1;
+    }
+
+    double elapsedSeconds = TriElapsedMs(start) / 1000.0;
+    std::string deviceName = triApp->GetDeviceName();
+    uint64_t primitivesPerFrame = triApp->GetPrimitivesPerFrame();
+    TriStepTimer initSteps = triApp->GetInitSteps();
+
+    TriGpuScopeResult drawScope;
+    const TriGpuScopeResult *lastDrawScope =
+        triApp->GetGpuProfiler().FindResult("draw");
+    if (lastDrawScope)
+        drawScope = *lastDrawScope;
+
+    triApp->Finalize();
+
+    std::ofstream out(options.outputPath);
+    if (!out.good())
+    {
+        TriLogError() << "Failed to open " << options.outputPath;
+        return 1;
+    }
+
+    // Driver-provided strings may hold anything; keep the JSON valid
+    std::string escapedName;
+    AppendJsonEscaped(escapedName, deviceName.c_str());
+
+    out << "{\n";
+    out << "  \"device\": \"" << escapedName << "\",\n";
+    out << "  \"headless\": " << (settings.headless ? "true" : "false")
+        << ",\n";
+    out << "  \"present_mode\": \""
+        << (settings.headless ? "none"
+                              : TriPresentModeName(settings.presentMode))
+        << "\",\n";
+    out << "  \"frames_in_flight\": " << settings.framesInFlight << ",\n";
+    out << "  \"warmup_frames\": " << options.warmupFrames << ",\n";
+    out << "  \"frames\": " << cpuFrame.Count() << ",\n";
+    out << "  \"skipped_frames\": " << skippedFrames << ",\n";
+    out << "  \"duration_s\": " << elapsedSeconds << ",\n";
+    double fps =
+        elapsedSeconds > 0.0 ? cpuFrame.Count() / elapsedSeconds : 0.0;
+    out << "  \"fps\": " << fps << ",\n";
+    out << "  \"instances\": " << settings.instances << ",\n";
+    out << "  \"static_instances\": "
+        << (settings.staticInstances ? "true" : "false") << ",\n";
+    out << "  \"gpu_culling\": " << (settings.gpuCulling ? "true" : "false")
+        << ",\n";
+    out << "  \"primitives_per_frame\": " << primitivesPerFrame << ",\n";
+    out << "  \"primitives_per_s\": " << fps * primitivesPerFrame << ",\n";
+    out << "  \"init_ms\": " << initSteps.TotalMs() << ",\n";
+    out << "  \"init_steps_ms\": {";
+    for (size_t i = 0; i < initSteps.GetSteps().size(); i++)
+    {
+        const auto &step = initSteps.GetSteps()[i];
+        out << (i == 0 ? "" : ", ") << "\"" << step.first
+            << "\": " << step.second;
+    }
+    out << "},\n";
+    out << "  \"host_allocator\": \""
+        << TriHostAllocatorName(settings.hostAllocator) << "\",\n";
+    out << "  \"host_alloc\": {";
+    for (uint32_t i = 0; i < TRI_HOST_ALLOC_SCOPES; i++)
+    {
+        VkSystemAllocationScope scope = static_cast<VkSystemAllocationScope>(i);
+        TriHostAllocStats stats = triApp->GetHostAllocator().GetStats(scope);
+        out << (i == 0 ? "" : ", ") << "\"" << TriAllocationScopeName(scope)
+            << "\": {\"allocations\": " << stats.allocations
+            << ", \"peak_bytes\": " << stats.peakBytes << "}";
+    }
+    out << "},\n";
+    WriteSeries(out, "cpu_frame_ms", cpuFrame);
+    WriteSeries(out, "fence_wait_ms", fenceWait);
+    WriteSeries(out, "acquire_ms", acquire);
+    WriteSeries(out, "present_ms", present);
+    WriteSeries(out, "instance_update_ms", instanceUpdate);
+    WriteSeries(out, "record_ms", record);
+    WriteSeries(out, "submit_ms", submit);
+    WriteSeries(out, "cpu_busy_ms", cpuBusy);
+    out << "  \"gpu_timed_frames\": " << gpuFrame.Count() << ",\n";
+    out << "  \"gpu_bound\": "
+        << (gpuFrame.Count() != 0 && gpuFrame.Mean() >= cpuBusy.Mean()
+                ? "true"
+                : "false")
+        << ",\n";
+    out << "  \"gpu_draw_stats\": {";
+    if (drawScope.hasStats)
+    {
+        out << "\"vertex_invocations\": " << drawScope.stats.vertexInvocations
+            << ", \"clipping_invocations\": "
+            << drawScope.stats.clippingInvocations
+            << ", \"clipping_primitives\": "
+            << drawScope.stats.clippingPrimitives
+            << ", \"fragment_invocations\": "
+            << drawScope.stats.fragmentInvocations;
+    }
+    out << "},\n";
+    WriteSeries(out, "gpu_frame_ms", gpuFrame);
+    WriteSeries(out, "gpu_cull_ms", gpuCull);
+    WriteSeries(out, "gpu_draw_ms", gpuDraw, true);
+    out << "}\n";
+
+    TriLogInfo() << "Benchmark of " << cpuFrame.Count() << " frames written to "
+                 << options.outputPath;
+
+    TriLogStop();
+
+    return 0;
+}
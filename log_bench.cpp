@@ -0,0 +1,133 @@
+#include "TriFrameStats.hpp"
+#include "TriLog.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+/* tri_log_bench: times a hot loop with and without a TriLogVerbose() line in
+   its body. With verbose lines compiled out (log_level above verbose, which
+   is what release builds get by default) both loops must run at the same
+   speed and the arguments of the log line must never be evaluated; the exit
+   status is 1 otherwise. With verbose lines compiled in it reports what a
+   line costs instead.
+
+   The loops are kept out of line so that the claim can be checked on the
+   binary as well: with verbose compiled out, LoggingLoop() disassembles to
+   the same instructions as BaselineLoop(), with no call into TriLogger, e.g.
+   objdump -dC --no-show-raw-insn tri_log_bench | grep -A12 'LoggingLoop.*>:'
+*/
+
+#define TRI_LOG_BENCH_RUNS 5
+
+// Largest LoggingLoop/BaselineLoop ratio still counted as noise
+#define TRI_LOG_BENCH_TOLERANCE 1.25
+
+static uint64_t gEvaluations = 0;
+
+// Stands in for an expensive log argument, e.g. a device query
+static uint64_t Evaluate(uint64_t value)
+{
+    gEvaluations++;
+    return value * 2654435761u;
+}
+
+__attribute__((noinline)) static uint64_t BaselineLoop(uint64_t iterations)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i++)
+        sum += i ^ (sum >> 3);
+
+    return sum;
+}
+
+__attribute__((noinline)) static uint64_t LoggingLoop(uint64_t iterations)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        sum += i ^ (sum >> 3);
+        TriLogVerbose() << "Iteration " << i << ": " << Evaluate(sum);
+    }
+
+    return sum;
+}
+
+// Fastest of a few runs, in milliseconds
+template <typename Loop>
+static double Time(Loop loop, uint64_t iterations, uint64_t &result)
+{
+    double best = 0.0;
+
+    for (int run = 0; run < TRI_LOG_BENCH_RUNS; run++)
+    {
+        TriClock::time_point start = TriClock::now();
+        result = loop(iterations);
+        double elapsed = TriElapsedMs(start);
+
+        best = run == 0 ? elapsed : std::min(best, elapsed);
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    constexpr bool compiledOut = !TriLogEnabled<TriLogVerbose>;
+
+    // Live log lines are far slower; keep that run short
+    uint64_t iterations = compiledOut ? 100000000 : 100000;
+    if (argc > 1)
+        iterations = std::strtoull(argv[1], nullptr, 10);
+
+    // Lines that do get logged go to a file, not the terminal
+    TriLogOptions options;
+    options.path = "tri_log_bench.log";
+    TriLogStart(options);
+
+    uint64_t baselineResult = 0;
+    uint64_t loggingResult = 0;
+    double baselineMs = Time(BaselineLoop, iterations, baselineResult);
+    double loggingMs = Time(LoggingLoop, iterations, loggingResult);
+
+    TriLogStop();
+
+    double ratio = baselineMs > 0.0 ? loggingMs / baselineMs : 1.0;
+
+    std::printf("verbose lines: %s\n",
+                compiledOut ? "compiled out" : "compiled in");
+    std::printf("iterations: %" PRIu64 "\n", iterations);
+    std::printf("baseline: %.3f ms (%.3f ns/iteration)\n", baselineMs,
+                baselineMs * 1e6 / iterations);
+    std::printf("logging: %.3f ms (%.3f ns/iteration)\n", loggingMs,
+                loggingMs * 1e6 / iterations);
+    std::printf("ratio: %.3f\n", ratio);
+    std::printf("argument evaluations: %" PRIu64 "\n", gEvaluations);
+
+    if (baselineResult != loggingResult)
+    {
+        std::printf("FAIL: the loops computed different results\n");
+        return 1;
+    }
+
+    if (!compiledOut)
+        return 0;
+
+    if (gEvaluations != 0)
+    {
+        std::printf("FAIL: arguments of compiled out lines were evaluated\n");
+        return 1;
+    }
+
+    if (ratio > TRI_LOG_BENCH_TOLERANCE)
+    {
+        std::printf("FAIL: compiled out lines still cost time\n");
+        return 1;
+    }
+
+    std::printf("PASS\n");
+
+    return 0;
+}
@@ -1,14 +1,27 @@
 #include "TriApp.hpp"
+#include "TriLog.hpp"
+#include "TriSettings.hpp"
 
 #include <memory>
 
-int main()
+int main(int argc, char **argv)
 {
-    std::unique_ptr<TriApp> triApp = std::make_unique<TriApp>("Tri", 800, 600);
+    TriSettings settings;
+    if (!ParseSettings(argc, argv, settings))
+    {
+        return 1;
+    }
+
+    TriLogStart(settings.log);
+
+    std::unique_ptr<TriApp> triApp =
+        std::make_unique<TriApp>("Tri", 800, 600, settings);
 
     triApp->Init();
     triApp->Loop();
     triApp->Finalize();
-    
+
+    TriLogStop();
+
     return 0;
 }